@@ -0,0 +1,28 @@
+TEMPLATE = app
+TARGET = psqp-bench
+
+CONFIG += console
+CONFIG -= app_bundle
+
+QMAKE_CXXFLAGS_RELEASE -= -O1
+QMAKE_CXXFLAGS_RELEASE -= -O2
+QMAKE_CXXFLAGS_RELEASE += -O3
+QMAKE_CXXFLAGS_WARN_ON += -Wno-unused-parameter
+
+QT += core \
+    gui
+LIBS += -L/usr/local/lib \
+    -lgmp \
+    -lpthread
+MOC_DIR += ./tmp
+INCLUDEPATH += $$PWD/../include/
+OBJECTS_DIR += ./obj
+
+# Library sources of PSQP, without its entry point and user interface
+SOURCES = $$files($$PWD/../src/*.cpp, true) \
+    $$PWD/benchmark.cpp
+SOURCES -= $$PWD/../src/main.cpp
+SOURCES -= $$files($$PWD/../src/ui/*.cpp, true)
+HEADERS = $$files($$PWD/../include/*.h, true)
+HEADERS -= $$PWD/../include/mainWindow.h
+HEADERS -= $$files($$PWD/../include/ui/*.h, true)
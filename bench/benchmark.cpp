@@ -0,0 +1,262 @@
+#include <QtGui>
+#include <iostream>
+#include <algorithm>
+#include <math.h>
+
+#include "tile/tiledImage.h"
+#include "tile/compatibility.h"
+#include "optimization/solver.h"
+#include "optimization/greedyPlacer.h"
+
+using namespace std;
+
+/**
+ * Default puzzle sizes (columns and rows), tile size and repetitions.
+ */
+#define BENCH_SIZES "10,20,50"
+#define BENCH_TILE_SIZE 28
+#define BENCH_REPEATS 5
+/**
+ * Descriptor parameters P and Q.
+ */
+#define BENCH_PARAM_P 0.3
+#define BENCH_PARAM_Q (1.0 / 16.0)
+
+/**
+ * Benchmarked stages.
+ */
+enum {
+    DESCRIPTORS, COMPATIBILITY, GRADIENT_DESCENT, SHIFT, NSTAGES
+};
+static const char *stageNames[NSTAGES] = {
+    "descriptors", "compatibility", "gradient_descent", "shift"
+};
+
+/**
+ * Drop the library's debug messages, so only the results are printed.
+ * */
+void benchMessageHandler(QtMsgType type, const char *msg) {
+    if (type == QtDebugMsg)
+        return;
+    cerr << msg << '\n';
+    if (type == QtFatalMsg)
+        abort();
+}
+
+/**
+ * Seeded pseudo-random generator (xorshift), the same on every platform.
+ * */
+static quint32 nextRandom(quint32 &state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+/**
+ * Uniform random number in [0, 1).
+ * */
+static double nextUniform(quint32 &state) {
+    return nextRandom(state) / 4294967296.0;
+}
+
+/**
+ * Generate a synthetic puzzle image: smooth waves of random frequency and
+ * phase per channel, plus a little noise, so borders of neighboring tiles
+ * match and every tile differs.
+ * */
+static QImage generateImage(int width, int height, quint32 seed) {
+    quint32 state = seed * 2654435761u + 1;
+    double fx[3][3], fy[3][3], phase[3][3];
+    for (int c = 0; c < 3; c++) {
+        for (int k = 0; k < 3; k++) {
+            fx[c][k] = (0.2 + 3.0 * nextUniform(state)) * 2.0 * M_PI / width;
+            fy[c][k] = (0.2 + 3.0 * nextUniform(state)) * 2.0 * M_PI / height;
+            phase[c][k] = 2.0 * M_PI * nextUniform(state);
+        }
+    }
+
+    QImage image(width, height, QImage::Format_RGB32);
+    int value[3];
+    double wave;
+    for (int y = 0; y < height; y++) {
+        QRgb *line = (QRgb*) image.scanLine(y);
+        for (int x = 0; x < width; x++) {
+            for (int c = 0; c < 3; c++) {
+                wave = 0.0;
+                for (int k = 0; k < 3; k++)
+                    wave += sin(fx[c][k] * x + fy[c][k] * y + phase[c][k]);
+                value[c] = qBound(0, (int) (128.0 + 38.0 * wave + 8.0 * nextUniform(state)), 255);
+            }
+            line[x] = qRgb(value[0], value[1], value[2]);
+        }
+    }
+    return image;
+}
+
+/**
+ * Generate a seeded random permutation (Fisher-Yates).
+ * */
+static int *generatePermutation(int n, quint32 seed) {
+    quint32 state = seed * 2246822519u + 7;
+    int *perm = new int[n];
+    for (int i = 0; i < n; i++)
+        perm[i] = i;
+    int j, aux;
+    for (int i = n - 1; i > 0; i--) {
+        j = nextRandom(state) % (i + 1);
+        aux = perm[i];
+        perm[i] = perm[j];
+        perm[j] = aux;
+    }
+    return perm;
+}
+
+/**
+ * Compute the median of a list of times.
+ * */
+static double median(QVector<double> times) {
+    qSort(times);
+    int n = times.size();
+    return (n % 2 == 1) ? times[n / 2] : (times[n / 2 - 1] + times[n / 2]) / 2.0;
+}
+
+/**
+ * Elapsed wall time of a timer, in milliseconds.
+ * */
+static double elapsedMs(QElapsedTimer &timer) {
+    return timer.nsecsElapsed() / 1000000.0;
+}
+
+int main(int argc, char *argv[]) {
+    qInstallMsgHandler(benchMessageHandler);
+    QCoreApplication app(argc, argv);
+
+    // Read options
+    QString sizes = BENCH_SIZES;
+    QString desc = "Pomeranz";
+    int tileSize = BENCH_TILE_SIZE;
+    int repeats = BENCH_REPEATS;
+    quint32 seed = 1;
+    bool sparse = false;
+    for (int i = 1; i < argc; i++) {
+        QString option = argv[i];
+        if (option == "--sizes" && i + 1 < argc)
+            sizes = argv[++i];
+        else if (option == "--tile-size" && i + 1 < argc)
+            tileSize = atoi(argv[++i]);
+        else if (option == "--repeats" && i + 1 < argc)
+            repeats = atoi(argv[++i]);
+        else if (option == "--seed" && i + 1 < argc)
+            seed = atoi(argv[++i]);
+        else if (option == "--descriptor" && i + 1 < argc)
+            desc = argv[++i];
+        else if (option == "--sparse")
+            sparse = true;
+        else {
+            cout << "Usage: psqp-bench [--sizes <n,n,...>] [--tile-size <pixels>] "
+                    "[--repeats <n>] [--seed <n>] [--descriptor <name>] [--sparse]" << '\n';
+            return -1;
+        }
+    }
+    if (tileSize < 2 || repeats < 1)
+        qFatal("Tiles need at least 2 pixels per side, and at least one run is needed.\n");
+
+    cout << "# seed " << seed << ", tile size " << tileSize << ", " << repeats << " runs, "
+         << qPrintable(desc) << (sparse ? ", sparse" : "") << ", "
+         << QThreadPool::globalInstance()->maxThreadCount() << " threads" << '\n';
+    cout << "size\ttiles\tstage\tmedian_ms\tmin_ms\tthroughput\tunit" << '\n';
+
+    QStringList sizeList = sizes.split(",");
+    for (int s = 0; s < sizeList.size(); s++) {
+        int n = sizeList[s].toInt();
+        int ntiles = n * n;
+        if (n < 2)
+            qFatal("Puzzles need at least 2 columns and rows.\n");
+
+        // Same puzzle and shuffle on every run, for a given seed and size
+        QImage image = generateImage(n * tileSize, n * tileSize, seed + n);
+        int *shuffle = generatePermutation(ntiles, seed + n);
+
+        QVector<double> times[NSTAGES];
+        QVector<double> iterations;
+        double direct = 0.0;
+        QElapsedTimer timer;
+        for (int run = 0; run < repeats; run++) {
+            TiledImage tiledImage(&image, n, n);
+            tiledImage.permutTiles(shuffle);
+
+            timer.start();
+            tiledImage.setDescriptor(desc, BENCH_PARAM_P, BENCH_PARAM_Q);
+            times[DESCRIPTORS] << elapsedMs(timer);
+
+            timer.start();
+            Compatibility *compat = new Compatibility(&tiledImage);
+            times[COMPATIBILITY] << elapsedMs(timer);
+
+            // Uniform start, as the solver's (sparse mode needs no initial matrix)
+            float **pInit = NULL;
+            if (!sparse) {
+                pInit = new float*[ntiles];
+                for (int i = 0; i < ntiles; i++) {
+                    pInit[i] = new float[ntiles];
+                    for (int j = 0; j < ntiles; j++)
+                        pInit[i][j] = 1.0f / ntiles;
+                }
+            }
+            timer.start();
+            // Sparse candidates start from a greedy placement, as the solver's
+            int *prior = NULL;
+            if (sparse) {
+                GreedyPlacer placer(compat, n, n);
+                prior = placer.solve(compat->getCompatibilityMatrix()[0],
+                                     compat->getCompatibilityMatrix()[1], NULL);
+            }
+            Optimizer *optimizer = Solver::createOptimizer("GradientDescent", compat, n, n,
+                                                           sparse, prior, 0.0);
+            int *perm = optimizer->solve(compat->getCompatibilityMatrix()[0],
+                                         compat->getCompatibilityMatrix()[1], pInit);
+            times[GRADIENT_DESCENT] << elapsedMs(timer);
+            iterations << optimizer->getIterations();
+            delete optimizer;
+            delete[] prior;
+            if (pInit != NULL) {
+                for (int i = 0; i < ntiles; i++)
+                    delete[] pInit[i];
+                delete[] pInit;
+            }
+            delete compat;
+            tiledImage.permutTiles(perm);
+            delete[] perm;
+
+            Solver solver(&tiledImage);
+            timer.start();
+            perm = solver.optimizeShift();
+            times[SHIFT] << elapsedMs(timer);
+            tiledImage.permutTiles(perm);
+            delete[] perm;
+
+            tiledImage.computeMetrics();
+            direct += tiledImage.getDirectAccuracy();
+        }
+        delete[] shuffle;
+
+        // Throughput of each stage, in the unit of work it does
+        double work[NSTAGES];
+        const char *units[NSTAGES] = {"tiles/s", "pairs/s", "iterations/s", "tiles/s"};
+        work[DESCRIPTORS] = ntiles;
+        work[COMPATIBILITY] = 4.0 * ntiles * (ntiles - 1);
+        work[GRADIENT_DESCENT] = median(iterations);
+        work[SHIFT] = ntiles;
+        for (int k = 0; k < NSTAGES; k++) {
+            double med = median(times[k]);
+            double best = *std::min_element(times[k].begin(), times[k].end());
+            cout << n << "x" << n << '\t' << ntiles << '\t' << stageNames[k] << '\t'
+                 << med << '\t' << best << '\t'
+                 << ((med > 0.0) ? work[k] / (med / 1000.0) : 0.0) << '\t' << units[k] << '\n';
+        }
+        cout << n << "x" << n << '\t' << ntiles << '\t' << "direct_accuracy" << '\t'
+             << direct / repeats << "\t-\t-\t%" << '\n';
+    }
+    return 0;
+}
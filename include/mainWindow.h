@@ -4,8 +4,14 @@
 #include <QtGui>
 #include "ui_mainWindow.h"
 #include "ui/graphicsScene.h"
+#include "ui/solverThread.h"
 #include "psqp.h"
 
+/**
+ * Time budget of local search refinement, in milliseconds.
+ */
+#define REFINE_TIME_BUDGET 5000
+
 namespace Ui {
     class MainWindow;
 }
@@ -26,13 +32,29 @@ public:
 
 private slots:
     /**
-     * @brief Slot to update puzzle size.
+     * @brief Slot to update puzzle size, or to reload the puzzle file.
      */
     void updatePuzzle();
     /**
      * @brief Slot to solve puzzle.
      */
     void solvePuzzle();
+    /**
+     * @brief Slot to ask the running solver to stop.
+     */
+    void cancelSolver();
+    /**
+     * @brief Slot to show the solver's progress.
+     * @param done Work done.
+     * @param total Total work.
+     * @param iteration Current iteration.
+     * @param cost Current cost of the relaxed problem.
+     */
+    void solverProgress(int done, int total, int iteration, double cost);
+    /**
+     * @brief Slot to show the solution once the solver thread is done.
+     */
+    void solverFinished();
     /**
      * @brief Slot to ramdonly permut tiles.
      */
@@ -41,6 +63,14 @@ private slots:
      * @brief Slot to optimize shift of current solution.
      */
     void optimizeShift();
+    /**
+     * @brief Slot to refine current solution by local search.
+     */
+    void refine();
+    /**
+     * @brief Slot to undo the last permutation of the tiles.
+     */
+    void undoPermutation();
 
     /**
      * @brief Slot to open new image.
@@ -68,10 +98,17 @@ private:
      */
     void createDock();
     /**
-     * @brief Load selected image.
+     * @brief Load selected image, or puzzle file (.psqp).
      */
     void loadImage(QString filename);
 
+    /**
+     * @brief Enable or disable the actions that change the puzzle
+     *        while the solver is running.
+     * @param solving Whether the solver is running.
+     */
+    void setSolving(bool solving);
+
     /**
      * Puzzle solver object.
      */
@@ -83,11 +120,18 @@ private:
     QFrame *mainFrame;
     QDockWidget *dock;
     QGraphicsView *graphicsView;
-    QPushButton *resetPuzzleButton, *randomGridButton, *quadProgButton, *shiftButton;
+    QPushButton *resetPuzzleButton, *randomGridButton, *quadProgButton, *shiftButton,
+                *refineButton, *undoButton, *cancelButton;
+    QProgressBar *progressBar;
     QSpinBox *hGridSpin, *wGridSpin;
     QDoubleSpinBox *pSpin, *qSpin;
-    QComboBox *descriptorCombo;
+    QComboBox *descriptorCombo, *solverCombo;
     GraphicsScene *graphicsScene;
+
+    /**
+     * Worker thread running the solver.
+     */
+    SolverThread *solverThread;
     
     Ui::MainWindow *ui;
 
@@ -96,6 +140,11 @@ private:
      */
     int ncols, nrows;
     float paramP, paramQ;
+
+    /**
+     * Puzzle file loaded (empty when the puzzle is cut from an image).
+     */
+    QString puzzleFile;
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,63 @@
+#ifndef ASSIGNMENT_H
+#define ASSIGNMENT_H
+
+#include <QtGui>
+
+using namespace std;
+
+/**
+ * @brief Linear assignment problem (LAP) solver.
+ */
+class Assignment {
+public:
+    /**
+     * @brief Find the minimum cost assignment of rows to columns,
+     *        by the Hungarian method (shortest augmenting paths), in O(n^3).
+     * @param cost Cost matrix (n x n), cost[i][j] of assigning row i to column j.
+     * @param n Number of rows and columns.
+     * @return Column assigned to each row.
+     */
+    static int *solve(float **cost, int n);
+
+    /**
+     * Struct to store a row of a sparse cost matrix: its explicit entries,
+     * every other column costing the row's default cost.
+     */
+    struct sparseRow {
+        int *cols;
+        float *cost;
+        int size;
+        float defaultCost;
+    };
+
+    /**
+     * @brief Find the minimum cost assignment of rows to columns of a sparse
+     *        cost matrix, in O(n^3) time but O(n + entries) memory.
+     * @param rows Rows of the cost matrix.
+     * @param n Number of rows and columns.
+     * @return Column assigned to each row.
+     */
+    static int *solve(sparseRow *rows, int n);
+
+    /**
+     * @brief Find a low cost assignment greedily, in O(n^2) and O(n) memory:
+     *        rows take their cheapest free column, the rows with the
+     *        cheapest columns first. Used when there is no time left for
+     *        an optimal assignment.
+     * @param cost Cost matrix (n x n), cost[i][j] of assigning row i to column j.
+     * @param n Number of rows and columns.
+     * @return Column assigned to each row.
+     */
+    static int *solveGreedy(float **cost, int n);
+
+    /**
+     * @brief Find a low cost assignment of a sparse cost matrix greedily,
+     *        in O(n log n + entries).
+     * @param rows Rows of the cost matrix.
+     * @param n Number of rows and columns.
+     * @return Column assigned to each row.
+     */
+    static int *solveGreedy(sparseRow *rows, int n);
+};
+
+#endif // ASSIGNMENT_H
@@ -0,0 +1,93 @@
+#ifndef BITSET_H
+#define BITSET_H
+
+#include <QtGui>
+
+/**
+ * @brief Fixed-size set of flags packed into 64-bit words, so loops can
+ *        test and skip 64 flags at a time.
+ */
+class BitSet {
+public:
+    /**
+     * @brief BitSet constructor.
+     */
+    BitSet(): words(NULL), nbits(0), nwords(0) {
+    }
+    ~BitSet() {
+        free(words);
+    }
+
+    /**
+     * @brief Resize the set and clear all its flags.
+     * @param nbits Number of flags.
+     */
+    void resize(int nbits) {
+        free(words);
+        this->nbits = nbits;
+        nwords = (nbits + 63) / 64;
+        words = (quint64*) calloc(nwords, sizeof(quint64));
+    }
+
+    /**
+     * @brief Get flag i.
+     * @param i
+     * @return Whether flag i is set.
+     */
+    bool test(int i) const {
+        return (words[i >> 6] >> (i & 63)) & 1;
+    }
+
+    /**
+     * @brief Set flag i.
+     * @param i
+     */
+    void set(int i) {
+        words[i >> 6] |= ((quint64) 1) << (i & 63);
+    }
+
+    /**
+     * @brief Get number of words.
+     * @return Number of words.
+     */
+    int getNWords() const {
+        return nwords;
+    }
+
+    /**
+     * @brief Get word w, holding flags 64*w to 64*w+63.
+     * @param w
+     * @return Word w.
+     */
+    quint64 word(int w) const {
+        return words[w];
+    }
+
+    /**
+     * @brief Get the bits of word w that hold flags (the last word may be partial).
+     * @param w
+     * @return Mask of valid bits in word w.
+     */
+    quint64 mask(int w) const {
+        if (w < nwords - 1 || (nbits & 63) == 0)
+            return ~((quint64) 0);
+        return (((quint64) 1) << (nbits & 63)) - 1;
+    }
+
+    /**
+     * @brief Get the index of the lowest set bit of a non-zero word.
+     * @param word
+     * @return Index of the lowest set bit.
+     */
+    static int lowestBit(quint64 word) {
+        return __builtin_ctzll(word);
+    }
+
+private:
+    Q_DISABLE_COPY(BitSet)
+
+    quint64 *words;
+    int nbits, nwords;
+};
+
+#endif // BITSET_H
@@ -0,0 +1,85 @@
+#ifndef FRANKWOLFE_H
+#define FRANKWOLFE_H
+
+#include <QtGui>
+
+#include "optimization/optimizer.h"
+
+using namespace std;
+
+/**
+ * Maximum number of Frank-Wolfe iterations.
+ */
+#define FW_MAX_ITERATIONS 500
+/**
+ * Relative duality gap for Frank-Wolfe to stop.
+ */
+#define FW_GAP_THRESHOLD 0.0001
+/**
+ * Number of steps of the progress reported to the solver monitor.
+ */
+#define FW_PROGRESS_STEPS 1000
+
+/**
+ * @brief Frank-Wolfe (conditional gradient) optimization. Each iteration
+ *        moves the permutation matrix towards the permutation minimizing
+ *        the linearized cost, found as a linear assignment problem.
+ */
+class FrankWolfe: public Optimizer {
+public:
+    /**
+     * @brief Frank-Wolfe constructor.
+     * @param ncols Number of columns of the puzzle.
+     * @param nrows Number of rows of the puzzle.
+     */
+    FrankWolfe(int ncols, int nrows);
+    ~FrankWolfe();
+
+    /**
+     * @brief Run optimization to solve puzzle.
+     * @param hCompat Horizontal compatibility matrix.
+     * @param vCompat Vertical compatibility matrix.
+     * @param pInit Initial permutation matrix.
+     * @return Solution's permutation.
+     */
+    int *solve(float** hCompat, float** vCompat, float **pInit);
+
+private:
+    /**
+     * @brief Compute gradient of the cost at the current permutation matrix.
+     */
+    void computeGradient();
+
+    /**
+     * @brief Compute cost of a permutation.
+     * @param perm Position of each tile.
+     * @return Cost of the permutation.
+     */
+    double computeCost(int *perm);
+
+    /**
+     * @brief Compute the progress of the solve, as the fraction of the
+     *        iteration limit or of the time budget spent.
+     * @param timer Timer started with the optimization.
+     * @param iterations Number of iterations run.
+     * @return Progress, out of FW_PROGRESS_STEPS.
+     */
+    int computeProgress(QElapsedTimer &timer, int iterations);
+
+    /**
+     * Information about puzzle.
+     */
+    int ncols, nrows, ntiles;
+
+    /**
+     * Compatibility matrices.
+     */
+    float **hCompat, **vCompat;
+
+    /**
+     * Current permutation matrix and cost gradient.
+     */
+    float **p, **grad;
+};
+
+#endif // FRANKWOLFE_H
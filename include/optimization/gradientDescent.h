@@ -4,6 +4,8 @@
 #include <QtGui>
 
 #include "tile/tile.h"
+#include "optimization/optimizer.h"
+#include "optimization/bitSet.h"
 
 using namespace std;
 
@@ -15,11 +17,27 @@ using namespace std;
  * Threshold for a value to be considered one.
  */
 #define MAX_THRESHOLD 0.9999999
+/**
+ * Number of best matches of a neighbor's tile that join a tile's
+ * candidates in sparse mode.
+ */
+#define SPARSE_MATCHES 8
+/**
+ * Number of iterations between progress reports to the solver monitor.
+ */
+#define GD_PROGRESS_INTERVAL 10
+/**
+ * Fraction of the tiles left unclamped at which descent stops and
+ * the remaining tiles are assigned by a linear assignment.
+ */
+#ifndef LAP_THRESHOLD
+#define LAP_THRESHOLD 0.1
+#endif
 
 /**
  * @brief Gradient descent optimization.
  */
-class GradientDescent {
+class GradientDescent: public Optimizer {
 public:
     /**
      * @brief Gradient Descent constructor.
@@ -39,12 +57,51 @@ public:
      */
     int *solve(float** hCompat, float** vCompat, float **pInit);
 
+    /**
+     * @brief Store only the live (non zeroed) entries of the permutation matrix,
+     *        as per-tile lists of candidate positions. Candidates start from the
+     *        nonzero entries of pInit or, if pInit is NULL, from the prior and
+     *        the best matches of its neighbors. Without a prior, the tiles are
+     *        placed greedily to get one.
+     *        When a tile is clamped, the best matches of its position join its
+     *        free neighbors' candidates. Zeroed entries are dropped from storage.
+     * @param sparse Whether to run in sparse mode.
+     */
+    void setSparse(bool sparse);
+
+    /**
+     * @brief Set a prior permutation (e.g. from a greedy placer) that keeps
+     *        being blended into the permutation matrix when it restarts
+     *        after a clamp, instead of restarting from uniform values.
+     * @param prior Position of each tile in the prior, or NULL for none.
+     * @param weight Weight of the prior, between 0 and 1.
+     */
+    void setPrior(int *prior, float weight);
+
+    /**
+     * Struct to store a tile's live candidate positions in sparse mode.
+     */
+    struct candidates {
+        int *pos;
+        float *p, *dF;
+        int size, capacity;
+    };
+
 private:
     /**
      * @brief Compute descent vector.
      */
     void computeDescentVector();
     
+    /**
+     * @brief Add the contribution of a neighbor to a tile's descent vector.
+     * @param i Tile receiving the contribution.
+     * @param j Neighboring tile.
+     * @param compat Compatibility matrix across the edge.
+     * @param transposed Whether tile i is on the second side of the edge.
+     */
+    void addContribution(int i, int j, float **compat, bool transposed);
+
     /**
      * @brief Constrain descent vector to comply to the problem's 
      *        constraints (each column/row must sum up to 1).
@@ -66,6 +123,77 @@ private:
      */
     void restartPermutation();
 
+    /**
+     * @brief Assign the unclamped tiles to the free positions by a linear
+     *        assignment, either maximizing the sum of their values in
+     *        the permutation matrix or, in the endgame, minimizing the
+     *        descent vector (the cost linearized around the current matrix).
+     * @param linearize Whether to use the linearized cost.
+     * @param bounded Whether to assign greedily, in O(n^2), rather than optimally.
+     */
+    void finishAssignment(bool linearize, bool bounded);
+
+    /**
+     * @brief Compute the cost of the relaxed problem over the unclamped tiles,
+     *        p' * dF / 2, from the descent vector before it is constrained.
+     * @return Relaxed cost.
+     */
+    double computeRelaxedCost();
+
+    /**
+     * @brief Build candidate lists from the initial permutation matrix,
+     *        or from the prior (which must be set) if it is NULL.
+     * @param pInit Initial permutation matrix or NULL.
+     */
+    void initSparse(float **pInit);
+
+    /**
+     * @brief Append a candidate position to a tile's candidates.
+     * @param row Candidates of the tile.
+     * @param pos Candidate position.
+     * @param p Value of the candidate in the permutation matrix.
+     */
+    void appendCandidate(candidates &row, int pos, float p);
+
+    /**
+     * @brief Add the best matches of a neighbor's position to a tile's candidates.
+     * @param row Candidates of the tile.
+     * @param pos Position of the neighboring tile.
+     * @param compat Compatibility matrix across the edge.
+     * @param transposed Whether the tile is on the second side of the edge.
+     */
+    void addMatches(candidates &row, int pos, float **compat, bool transposed);
+
+    /**
+     * @brief Add the best matches of a tile's position to its free neighbors' candidates.
+     * @param i Tile.
+     * @param pos Position of the tile.
+     */
+    void addNeighborMatches(int i, int pos);
+
+    /**
+     * @brief Sparse counterparts of the descent steps above.
+     */
+    void computeSparseDescentVector();
+    void constrainSparseDescentVector();
+    void updateSparsePermutation();
+    double computeSparseStep();
+    void restartSparsePermutation();
+
+    /**
+     * @brief Add the contribution of a neighbor's candidates to a tile's descent vector.
+     * @param row Candidates of the tile.
+     * @param other Candidates of the neighboring tile.
+     * @param compat Compatibility matrix across the edge.
+     * @param transposed Whether the tile is on the second side of the edge.
+     */
+    void addSparseContribution(candidates &row, candidates &other, float **compat, bool transposed);
+
+    /**
+     * @brief Drop zeroed candidates and clamped positions from unclamped tiles.
+     */
+    void compactCandidates();
+
     /**
      * Tiles to run optimization.
      */
@@ -100,17 +228,37 @@ private:
     /**
      * Whether a tile has been clamped.
      */
-    bool *clampedTile;
+    BitSet clampedTile;
     
     /**
      * Whether a position has been assigned a tile.
      */
-    bool *clampedPosition;
+    BitSet clampedPosition;
 
     /**
      * Whether a value in the permutation matrix is close to zero.
      */
-    bool **zeroed;
+    BitSet *zeroed;
+
+    /**
+     * Number of 64-bit words in each row of flags.
+     */
+    int nwords;
+
+    /**
+     * Sparse mode: live candidates of each tile, and per position accumulators
+     * for the constraint projection.
+     */
+    bool sparse;
+    candidates *rows;
+    float *colSum;
+    int *colCount;
+
+    /**
+     * Prior permutation and its weight.
+     */
+    int *prior;
+    float priorWeight;
 
     /**
      * Solution's permutation.
@@ -0,0 +1,119 @@
+#ifndef GREEDYPLACER_H
+#define GREEDYPLACER_H
+
+#include <QtGui>
+
+#include "tile/compatibility.h"
+#include "optimization/optimizer.h"
+
+using namespace std;
+
+/**
+ * Number of unplaced candidates taken from each placed neighbor's
+ * sorted neighbor list when filling a position.
+ */
+#define GREEDY_CANDIDATES 4
+
+/**
+ * @brief Greedy constructive placement, in the style of best-buddy placers.
+ *        Starting from the tile with most best buddies, it repeatedly fills
+ *        the open position with the most compatible placement, drawing
+ *        candidates only from the sorted neighbor lists of the tiles around
+ *        that position, so it runs in near-linear time.
+ */
+class GreedyPlacer: public Optimizer {
+public:
+    /**
+     * @brief Greedy placer constructor.
+     * @param compat Compatibility between the tiles, or NULL to rank
+     *        neighbors by the compatibility matrices given to solve.
+     * @param ncols Number of columns of the puzzle.
+     * @param nrows Number of rows of the puzzle.
+     */
+    GreedyPlacer(Compatibility *compat, int ncols, int nrows);
+    ~GreedyPlacer();
+
+    /**
+     * @brief Run optimization to solve puzzle.
+     * @param hCompat Horizontal compatibility matrix.
+     * @param vCompat Vertical compatibility matrix.
+     * @param pInit Initial permutation matrix (unused).
+     * @return Solution's permutation.
+     */
+    int *solve(float** hCompat, float** vCompat, float **pInit);
+
+    /**
+     * Struct to store a candidate placement of a tile in a canvas slot.
+     */
+    struct placement {
+        float score, distance;
+        int slot, tile;
+    };
+
+private:
+    /**
+     * @brief Find the best placement for a free slot of the canvas.
+     * @param slot Slot of the canvas.
+     * @param best Best placement found.
+     * @return Whether a placement was found.
+     */
+    bool bestPlacement(int slot, placement &best);
+
+    /**
+     * @brief Whether a tile can be placed in a slot without the placed
+     *        tiles exceeding the puzzle's size.
+     * @param slot Slot of the canvas.
+     * @return Whether the slot is available.
+     */
+    bool isOpen(int slot);
+
+    /**
+     * @brief Compatibility of a tile placed in a slot with the tiles around it.
+     * @param slot Slot of the canvas.
+     * @param tile Tile.
+     * @return Sum of the compatibilities (lower is better).
+     */
+    float score(int slot, int tile);
+
+    /**
+     * @brief Rank each tile's neighbors by the compatibility matrices,
+     *        when no Compatibility was given.
+     */
+    void rankNeighbors();
+
+    /**
+     * @brief Find the tile with most best buddies, to start the placement.
+     * @return Seed tile.
+     */
+    int findSeed();
+
+    /**
+     * Information about puzzle.
+     */
+    int ncols, nrows, ntiles;
+
+    /**
+     * Compatibility between the tiles.
+     */
+    Compatibility::neighbor ***neighbors;
+    float **hCompat, **vCompat;
+    bool ownNeighbors;
+
+    /**
+     * Canvas large enough to grow the puzzle from any tile, with the
+     * tile placed in each slot (or -1), and the bounding box of the
+     * placed tiles.
+     */
+    int canvasCols, canvasRows;
+    int *canvas;
+    int minCol, maxCol, minRow, maxRow;
+
+    /**
+     * Whether a tile has been placed, and, for each tile and border,
+     * the rank of its first neighbor that may still be free.
+     */
+    bool *placed;
+    int **cursor;
+};
+
+#endif // GREEDYPLACER_H
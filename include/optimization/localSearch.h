@@ -0,0 +1,176 @@
+#ifndef LOCALSEARCH_H
+#define LOCALSEARCH_H
+
+#include <QtGui>
+
+#include "tile/tiledImage.h"
+
+using namespace std;
+
+/**
+ * Largest block of tiles (size x size) moved at once.
+ */
+#define LS_MAX_BLOCK 3
+/**
+ * Smallest cost decrease for a move to be considered an improvement.
+ */
+#define LS_EPSILON 0.000001
+
+/**
+ * @brief Local search refinement of a solution: tile swaps, block swaps and
+ *        row/column segment moves, each evaluated by the cost change of
+ *        the edges it affects only.
+ */
+class LocalSearch {
+public:
+    /**
+     * @brief Local search constructor. Caches the border distances
+     *        between every pair of tiles, until the time budget expires.
+     * @param tiledImage Tiled image, with the tiles at their current positions.
+     * @param timer Timer of the time budget, or NULL for no limit.
+     * @param timeBudget Time budget in milliseconds (0 for no limit).
+     */
+    LocalSearch(TiledImage *tiledImage, const QElapsedTimer *timer = NULL, int timeBudget = 0);
+    ~LocalSearch();
+
+    /**
+     * Move types.
+     */
+    static const int SWAP = 0;
+    static const int BLOCK = 1;
+    static const int ROW = 2;
+    static const int COLUMN = 3;
+
+    /**
+     * Struct to store a move: swap of positions a and b, swap of the
+     * size x size blocks at a and b, or rotation by b (1 or -1) of the
+     * row/column segment of length size starting at a.
+     */
+    struct move {
+        int type;
+        int a, b, size;
+        double delta;
+    };
+
+    /**
+     * Struct to store the moves searched by one thread: anchors
+     * first, first + stride, ... and its best move for each anchor.
+     */
+    struct searchTask {
+        LocalSearch *search;
+        int *perm;
+        int first, stride;
+        int *stamp, *tileAt, *positions, *newTiles;
+        int mark;
+        QVector<move> moves;
+    };
+
+    /**
+     * @brief Check whether every distance was cached within the time budget.
+     *        Only then can a solution be refined.
+     * @return Whether the cache is complete.
+     */
+    bool isCached();
+
+    /**
+     * @brief Improve a solution in place, applying improving moves until
+     *        none is found or the time budget expires.
+     * @param perm Tile at each position.
+     * @param timeBudget Time budget in milliseconds (0 for no limit).
+     * @return Number of applied moves.
+     */
+    int refine(int *perm, int timeBudget);
+
+    /**
+     * @brief Compute total cost of a solution from the cached distances
+     *        (same normalization as Solver's cost).
+     * @param perm Tile at each position.
+     * @return Computed cost.
+     */
+    double computeCost(int *perm);
+
+    /**
+     * @brief Find the best improving move of each anchor of a task,
+     *        among the moves involving a dirty position.
+     * @param task
+     */
+    void searchMoves(searchTask &task);
+
+    /**
+     * @brief Cache the distances of one tile to every other tile,
+     *        unless the time budget has expired.
+     * @param tile
+     * @return Whether the distances were cached.
+     */
+    bool computeDistances(int tile);
+
+private:
+    /**
+     * @brief Expand a move into the positions it changes and their new tiles.
+     * @param m Move.
+     * @param perm Tile at each position.
+     * @param positions Changed positions.
+     * @param newTiles New tile of each changed position.
+     * @return Number of changed positions.
+     */
+    int expandMove(const move &m, int *perm, int *positions, int *newTiles);
+
+    /**
+     * @brief Compute the cost change of a move over the edges it affects.
+     * @param task Task evaluating the move (holds its buffers).
+     * @param m Move.
+     * @return Cost change.
+     */
+    double computeDelta(searchTask &task, move &m);
+
+    /**
+     * @brief List the dirty positions, and the top left corners of the
+     *        blocks of each size holding a dirty position.
+     */
+    void collectDirty();
+
+    /**
+     * @brief Keep the move with the lowest cost change.
+     * @param task Task evaluating the move.
+     * @param m Candidate move.
+     * @param best Best move so far.
+     */
+    void tryMove(searchTask &task, move m, move &best);
+
+    /**
+     * Tiled image of the puzzle.
+     */
+    TiledImage *tiledImage;
+
+    /**
+     * Information about puzzle.
+     */
+    int ncols, nrows, ntiles;
+
+    /**
+     * Weighted distances: hDist[a][b] across tile a's right border
+     * and tile b's left border, vDist[a][b] across a's bottom and b's top.
+     */
+    float **hDist, **vDist;
+    float hWeight, vWeight;
+    bool cached;
+
+    /**
+     * Timer and time budget of the caching.
+     */
+    const QElapsedTimer *timer;
+    int timeBudget;
+
+    /**
+     * Dirty positions: positions whose tile or neighbors changed in the last
+     * round, or whose best move could not be applied (all of them in the
+     * first round). Only moves involving a dirty position are evaluated
+     * again, as the cost change of the others still holds.
+     */
+    bool *dirty;
+    QVector<int> dirtyPositions;
+    bool *dirtyBlock[LS_MAX_BLOCK + 1];
+    QVector<int> dirtyCorners[LS_MAX_BLOCK + 1];
+};
+
+#endif // LOCALSEARCH_H
@@ -0,0 +1,99 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <QtGui>
+
+#include "optimization/solverMonitor.h"
+
+using namespace std;
+
+/**
+ * @brief Optimization backend template. Backends find the permutation
+ *        minimizing the puzzle's cost, given the compatibility matrices.
+ */
+class Optimizer {
+public:
+    Optimizer(): monitor(NULL), timeBudget(0), iterationBudget(0), converged(false),
+            iterationCount(0) {
+    }
+    virtual ~Optimizer() {
+    }
+
+    /**
+     * @brief Set a monitor to report progress to and to check for cancellation.
+     *        A canceled backend stops at once, skipping its final rounding, and
+     *        returns a permutation meant to be discarded.
+     * @param monitor Solver monitor, or NULL for none.
+     */
+    void setMonitor(SolverMonitor *monitor) {
+        this->monitor = monitor;
+    }
+
+    /**
+     * @brief Limit the optimization. When the budget runs out, the backend
+     *        stops and returns the best solution it can round to at that point.
+     * @param timeBudget Time budget in milliseconds (0 for no limit).
+     * @param iterationBudget Maximum number of iterations (0 for no limit).
+     */
+    void setBudget(qint64 timeBudget, int iterationBudget) {
+        this->timeBudget = timeBudget;
+        this->iterationBudget = iterationBudget;
+    }
+
+    /**
+     * @brief Check whether the last solve converged, rather than
+     *        running out of budget or being canceled.
+     * @return Whether the last solve converged.
+     */
+    bool hasConverged() {
+        return converged;
+    }
+
+    /**
+     * @brief Get the number of iterations of the last solve.
+     * @return Number of iterations (0 for backends that do not iterate).
+     */
+    int getIterations() {
+        return iterationCount;
+    }
+
+    /**
+     * @brief Run optimization to solve puzzle.
+     * @param hCompat Horizontal compatibility matrix.
+     * @param vCompat Vertical compatibility matrix.
+     * @param pInit Initial permutation matrix.
+     * @return Solution's permutation.
+     */
+    virtual int *solve(float** hCompat, float** vCompat, float **pInit) = 0;
+
+protected:
+    /**
+     * @brief Check whether the budget ran out.
+     * @param timer Timer started with the optimization.
+     * @param iterations Number of iterations run.
+     * @return Whether the budget ran out.
+     */
+    bool budgetExpired(QElapsedTimer &timer, int iterations) {
+        return (timeBudget > 0 && timer.elapsed() >= timeBudget)
+                || (iterationBudget > 0 && iterations >= iterationBudget);
+    }
+
+    /**
+     * Solver monitor.
+     */
+    SolverMonitor *monitor;
+
+    /**
+     * Optimization budget.
+     */
+    qint64 timeBudget;
+    int iterationBudget;
+
+    /**
+     * Whether the last solve converged, and its number of iterations.
+     */
+    bool converged;
+    int iterationCount;
+};
+
+#endif // OPTIMIZER_H
@@ -4,6 +4,8 @@
 #include <QtGui>
 
 #include "tile/tiledImage.h"
+#include "tile/compatibility.h"
+#include "optimization/optimizer.h"
 
 using namespace std;
 
@@ -26,12 +28,148 @@ public:
     int *solve();
 
     /**
-     * @brief Find the best shift for current solution.
+     * @brief Find the best cyclic shift for current solution, scoring every
+     *        shift from the cost of the wrapped-around column and row boundaries.
      * @return Solution's permutation shifted by the best shift.
      */
     int *optimizeShift();
 
+    /**
+     * @brief Refine current solution by local search (tile swaps, block
+     *        swaps and row/column segment moves).
+     * @param timeBudget Time budget in milliseconds, caching the border distances included (0 for no limit).
+     * @return Refined solution's permutation.
+     */
+    int *refine(int timeBudget);
+
+    /**
+     * @brief Split the puzzle into overlapping windows, solved concurrently.
+     *        Tiles are first placed greedily, and each window rearranges
+     *        the tiles the greedy placement puts in it.
+     * @param windowSize Number of columns and rows of each window (0 solves the whole puzzle at once).
+     * @param overlap Number of columns and rows shared by neighboring windows.
+     */
+    void setWindows(int windowSize, int overlap);
+
+    /**
+     * @brief Run gradient descent on a sparse permutation matrix,
+     *        keeping only each tile's live candidate positions.
+     * @param sparse Whether to use the sparse permutation matrix.
+     */
+    void setSparse(bool sparse);
+
+    /**
+     * @brief Set optimization backend.
+     * @param backend Backend name (GradientDescent, FrankWolfe or Greedy).
+     */
+    void setBackend(QString backend);
+
+    /**
+     * @brief Start the solver near a greedy placement of the tiles, blending
+     *        it into the initial permutation matrix.
+     * @param weight Weight of the greedy placement, between 0 and 1 (0 disables it).
+     */
+    void setGreedyInit(float weight);
+
+    /**
+     * @brief Set a monitor to report progress to and to check for cancellation.
+     * @param monitor Solver monitor, or NULL for none.
+     */
+    void setMonitor(SolverMonitor *monitor);
+
+    /**
+     * @brief Limit each solve (anytime mode). When the budget runs out, the
+     *        solver returns the permutation rounded from its current state.
+     * @param timeBudget Time budget in milliseconds, from the start of the solve (0 for no limit).
+     * @param iterationBudget Maximum number of iterations of the backend (0 for no limit).
+     */
+    void setBudget(int timeBudget, int iterationBudget);
+
+    /**
+     * @brief Get the cost of the last solution (of the last solve, shift or refinement).
+     * @return Cost of the last solution.
+     */
+    float getCost();
+
+    /**
+     * @brief Check whether the last solve converged, rather than
+     *        running out of budget or being canceled.
+     * @return Whether the last solve converged.
+     */
+    bool hasConverged();
+
+    /**
+     * @brief Get the number of iterations of the backend in the last solve
+     *        (summed over windows).
+     * @return Number of iterations.
+     */
+    int getIterations();
+
+    /**
+     * @brief Get the wall time of the last solve's compatibility computation.
+     * @return Compatibility time, in milliseconds.
+     */
+    qint64 getCompatibilityTime();
+
+    /**
+     * @brief Get the wall time of the last solve's optimization (greedy
+     *        placement and backend, or windows).
+     * @return Optimization time, in milliseconds.
+     */
+    qint64 getOptimizationTime();
+
+    /**
+     * @brief Create an optimization backend.
+     * @param backend Backend name.
+     * @param compat Compatibility between the tiles, or NULL if not available.
+     * @param ncols Number of columns of the puzzle.
+     * @param nrows Number of rows of the puzzle.
+     * @param sparse Whether gradient descent runs on a sparse permutation matrix.
+     * @param prior Prior permutation for gradient descent, or NULL for none.
+     * @param priorWeight Weight of the prior permutation.
+     * @return Optimization backend.
+     */
+    static Optimizer *createOptimizer(QString backend, Compatibility *compat, int ncols, int nrows,
+                                      bool sparse, int *prior, float priorWeight);
+
+    /**
+     * Struct to store a window of the puzzle and its partial solution.
+     */
+    struct window {
+        int col, row, ncols, nrows;
+        int *tiles;
+        int *solution;
+        float **hCompat, **vCompat;
+        bool sparse;
+        QString backend;
+        float priorWeight;
+        SolverMonitor *monitor;
+        QElapsedTimer *budgetTimer;
+        qint64 deadline;
+        int iterationBudget;
+        bool converged;
+        int iterations;
+    };
+
 private:
+    /**
+     * @brief Solve each window concurrently and reconcile their
+     *        overlapping placements into one permutation.
+     * @param hCompat Horizontal compatibility matrix.
+     * @param vCompat Vertical compatibility matrix.
+     * @param arrangement Tile of each position to start from.
+     * @return Solution's permutation.
+     */
+    int *solveWindows(float **hCompat, float **vCompat, int *arrangement);
+
+    /**
+     * @brief Compute window origins along one dimension of the puzzle.
+     * @param length Number of columns or rows of the puzzle.
+     * @param size Number of columns or rows of the window.
+     * @return Window origins.
+     */
+    QVector<int> windowOrigins(int length, int size);
+
     /**
      * @brief Compute total cost for given permutation.
      * @param Permutation of the tiles.
@@ -44,6 +182,41 @@ private:
      */
     TiledImage *tiledImage;
     int ncols, nrows, ntiles;
+
+    /**
+     * Window decomposition.
+     */
+    int windowSize, windowOverlap;
+
+    /**
+     * Whether gradient descent runs on a sparse permutation matrix.
+     */
+    bool sparse;
+
+    /**
+     * Optimization backend name.
+     */
+    QString backend;
+
+    /**
+     * Weight of the greedy placement in the initial permutation matrix.
+     */
+    float greedyWeight;
+
+    /**
+     * Solver monitor.
+     */
+    SolverMonitor *monitor;
+
+    /**
+     * Solve budget, and outcome of the last solve.
+     */
+    int timeBudget, iterationBudget;
+    QElapsedTimer budgetTimer;
+    float cost;
+    bool converged;
+    int iterations;
+    qint64 compatibilityTime, optimizationTime;
 };
 
 #endif // SOLVER_H
@@ -0,0 +1,59 @@
+#ifndef SOLVERMONITOR_H
+#define SOLVERMONITOR_H
+
+#include <QtGui>
+
+/**
+ * @brief Link between a running solver and the thread that started it:
+ *        the solver reports its progress through it, and checks it
+ *        for cancellation.
+ */
+class SolverMonitor: public QObject {
+    Q_OBJECT
+
+public:
+    /**
+     * @brief SolverMonitor constructor.
+     * @param parent Parent object.
+     */
+    SolverMonitor(QObject *parent = 0);
+
+    /**
+     * @brief Ask the running solver to stop. Safe to call from any thread.
+     */
+    void cancel();
+
+    /**
+     * @brief Clear a previous cancellation, before starting a new solve.
+     */
+    void reset();
+
+    /**
+     * @brief Check whether the solver was asked to stop.
+     * @return Whether the solver was canceled.
+     */
+    bool isCanceled();
+
+    /**
+     * @brief Report the solver's progress (called from the solver's thread).
+     * @param done Work done (e.g. clamped tiles, or a fraction of the budget).
+     * @param total Total work (e.g. number of tiles).
+     * @param iteration Current iteration.
+     * @param cost Current cost of the relaxed problem.
+     */
+    void reportProgress(int done, int total, int iteration, double cost);
+
+signals:
+    /**
+     * @brief Signal emitted with the solver's progress.
+     */
+    void progress(int done, int total, int iteration, double cost);
+
+private:
+    /**
+     * Whether the solver was asked to stop.
+     */
+    QAtomicInt canceled;
+};
+
+#endif // SOLVERMONITOR_H
@@ -25,9 +25,18 @@ public:
 
     /**
      * @brief Set puzzle image.
-     * @param imageFile Path to image file.
+     * @param imageFile Path to image file, or to the directory or manifest
+     *        of a pre-cut puzzle's tile images (see TiledImage::listTileFiles).
      */
     void setImage(QString imageFile);
+
+    /**
+     * @brief Stream the puzzle image instead of decoding it whole: only the
+     *        tiles' features are kept, and pixels are decoded band by band.
+     *        Call before PSQP::setImage, whose image must not be pre-cut.
+     * @param streaming Whether to stream the puzzle image.
+     */
+    void setStreaming(bool streaming);
     
     /**
      * @brief Set puzzle size.
@@ -36,6 +45,21 @@ public:
      */
     void setPuzzleSize(int ncols, int nrows);
 
+    /**
+     * @brief Load a puzzle file: sets the puzzle size and the descriptor
+     *        stored in it, without decoding any image.
+     * @param puzzleFile Path to puzzle file (see PuzzleFile).
+     */
+    void loadPuzzle(QString puzzleFile);
+
+    /**
+     * @brief Save the puzzle, in its current order, to a puzzle file.
+     *        Call after PSQP::setDescriptor.
+     * @param puzzleFile Path to puzzle file.
+     * @param thumbnailSize Size of the longest side of the tiles' thumbnails (0 for none).
+     */
+    void savePuzzle(QString puzzleFile, int thumbnailSize = PUZZLE_THUMBNAIL_SIZE);
+
     /**
      * @brief Set descriptor to describe tiles.
      * @param desc Name of the descriptor to compute distances between the tiles.
@@ -44,12 +68,63 @@ public:
      */
     void setDescriptor(QString desc, float paramP, float paramQ);
 
+    /**
+     * @brief Set window decomposition for the solver.
+     * @param windowSize Number of columns and rows of each window (0 solves the whole puzzle at once).
+     * @param overlap Number of columns and rows shared by neighboring windows.
+     */
+    void setWindows(int windowSize, int overlap);
+
+    /**
+     * @brief Run the solver on a sparse permutation matrix.
+     * @param sparse Whether to use the sparse permutation matrix.
+     */
+    void setSparse(bool sparse);
+
+    /**
+     * @brief Start the solver near a greedy placement of the tiles.
+     * @param weight Weight of the greedy placement, between 0 and 1 (0 disables it).
+     */
+    void setGreedyInit(float weight);
+
+    /**
+     * @brief Limit each solve (anytime mode).
+     * @param timeBudget Time budget in milliseconds (0 for no limit).
+     * @param iterationBudget Maximum number of iterations (0 for no limit).
+     */
+    void setBudget(int timeBudget, int iterationBudget);
+
+    /**
+     * @brief Get the cost of the last solution.
+     * @return Cost of the last solution.
+     */
+    float getCost();
+
+    /**
+     * @brief Check whether the last solve converged.
+     * @return Whether the last solve converged.
+     */
+    bool hasConverged();
+
+    /**
+     * @brief Set optimization backend for the solver.
+     * @param backend Name of the optimization backend.
+     */
+    void setSolver(QString backend);
+
     /**
      * @brief Get puzzle tiled image.
      * @return Puzzle tiled image.
      */
     TiledImage *getTiledImage();
 
+    /**
+     * @brief Get the monitor of the solver, to follow its progress
+     *        and cancel it from another thread.
+     * @return Solver monitor.
+     */
+    SolverMonitor *getMonitor();
+
     /**
      * @brief Run quadratic programming solver.
      */
@@ -60,22 +135,58 @@ public:
      */
     void optimizeShift();
 
+    /**
+     * @brief Run local search refinement.
+     * @param timeBudget Time budget in milliseconds (0 for no limit).
+     */
+    void refine(int timeBudget);
+
+    /**
+     * @brief Write a JSON report of the last run: accuracy, cost, wall time
+     *        of each stage, iterations, peak memory and thread count.
+     * @param reportFile Path to report file.
+     */
+    void writeReport(QString reportFile);
+
     /**
      * @brief Get descriptors' names.
      */
     QStringList getDescriptorNames();
 
+    /**
+     * @brief Get optimization backends' names.
+     */
+    QStringList getSolverNames();
+
 private:
+    /**
+     * @brief Create the solver for the tiled image, with the current settings.
+     */
+    void createSolver();
+
+    /**
+     * @brief Record the wall time of a stage, replacing its previous time.
+     * @param stage Stage name.
+     * @param time Wall time, in milliseconds.
+     */
+    void recordStage(QString stage, qint64 time);
+
     /**
      * Descriptors' names.
      * */ 
        QStringList descriptorOptions;
 
+    /**
+     * Optimization backends' names.
+     * */ 
+    QStringList solverOptions;
+
     /**
      * Puzzle image.
      * */ 
     QString imageFile;
     QImage *image;
+    bool streaming, preCut;
 
     /**
      * Puzzle image broken down into ncols x nrows tiles.
@@ -87,6 +198,19 @@ private:
      * Quadratic programming solver.
      * */ 
     Solver *solver;
+    SolverMonitor *monitor;
+    int windowSize, windowOverlap;
+    bool sparse;
+    QString backend;
+    float greedyWeight;
+    int timeBudget, iterationBudget;
+
+    /**
+     * Wall time of each stage of the last run, in the order they ran.
+     * */
+    QStringList stageNames;
+    QList<qint64> stageTimes;
+    QString descriptor;
 };
 
 #endif // PSQP_H
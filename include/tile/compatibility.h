@@ -5,7 +5,7 @@
 #include <math.h>
 #include <sstream>
 
-#include "tile/tile.h"
+#include "tile/tiledImage.h"
 
 using namespace std;
 
@@ -24,11 +24,10 @@ public:
 
     /**
      * @brief Compatibility constructor.
-     * @param tiles Tiles to compute compatibility.
-     * @param ncols Number of columns of the puzzle.
-     * @param nrows Number of rown of the puzzle.
+     * @param tiledImage Tiled image whose tiles, at their current
+     *        positions, compatibility is computed for.
      */
-    Compatibility(Tile *tiles, int ncols, int nrows);
+    Compatibility(TiledImage *tiledImage);
     ~Compatibility();
 
     /**
@@ -46,6 +45,12 @@ public:
      */
     float ***getCompatibilityMatrix();
 
+    /**
+     * @brief Get each tile's neighbors across each border, sorted by distance.
+     * @return Neighbors, indexed by tile, border and rank.
+     */
+    neighbor ***getNeighbors();
+
 private:
     /**
      * @brief Compute information on each tile's neighbors,
@@ -99,9 +104,9 @@ private:
     bool quartileEven;
     
     /**
-     * Tiles to compute compatibility
+     * Tiled image to compute compatibility
      */
-    Tile *tiles;
+    TiledImage *tiledImage;
 
     /**
      * Information about puzzle.
@@ -124,4 +129,9 @@ private:
     bool **constantBorders;
 };
 
+/**
+ * @brief Compare neighboring tiles by their feature vector distance (for qsort).
+ */
+int neighborsComparisonByDistance(const void *a, const void *b);
+
 #endif // COMPATIBILITY_H
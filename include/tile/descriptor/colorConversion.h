@@ -18,6 +18,16 @@ public:
         lab[2] = 7.0 * (0.211 * rgb[0] - 0.523 * rgb[1] + 0.312 * rgb[2]);
     }
 
+    /**
+     * @brief Convert a line of pixels from RGB to LAB, with a lookup table
+     *        of each channel's contribution for its 8-bit values. Gives the
+     *        same values as the per-pixel RGBtoLAB.
+     * @param rgb RGB values, 3 per pixel, integers from 0 to 255.
+     * @param lab LAB values, 3 per pixel (may be rgb, to convert in place).
+     * @param n Number of pixels.
+     */
+    static void RGBtoLAB(const float *rgb, float *lab, int n);
+
 private:
 };
 
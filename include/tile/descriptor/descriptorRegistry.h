@@ -0,0 +1,78 @@
+#ifndef DESCRIPTORREGISTRY_H
+#define DESCRIPTORREGISTRY_H
+
+#include <QtGui>
+
+#include "tile/descriptor/tileDescriptor.h"
+
+/**
+ * @brief Registry of the available tile descriptors, looked up by name.
+ *        Each descriptor declares how to create it, how many lines of pixels
+ *        its features hold, how to extract the features of a tile's four
+ *        borders and how to compute the distances from one border to many.
+ */
+class DescriptorRegistry {
+public:
+    /**
+     * Create a descriptor with parameters P and Q.
+     */
+    typedef TileDescriptor *(*Factory)(float paramP, float paramQ);
+
+    /**
+     * Create the feature vectors of a tile's four borders (descriptors are
+     * indexed by border), from an image with 32 bits per pixel.
+     */
+    typedef void (*FeatureExtractor)(TileDescriptor **descriptors, const QImage &image);
+
+    /**
+     * Compute the distances between one border's descriptor and the
+     * descriptors of the opposite border of n tiles.
+     */
+    typedef void (*BatchKernel)(TileDescriptor *descriptor, TileDescriptor **others, int n,
+                                bool param, float *distances);
+
+    /**
+     * Struct to store a registered descriptor.
+     */
+    struct entry {
+        const char *name;
+        int lines;
+        Factory create;
+        FeatureExtractor extract;
+        BatchKernel distances;
+    };
+
+    /**
+     * @brief Find a descriptor by name.
+     * @param name Descriptor name.
+     * @return Registered descriptor, or NULL if there is none with that name.
+     */
+    static const entry *find(QString name);
+
+    /**
+     * @brief Get the registered descriptors' names, the default one first.
+     * @return Descriptors' names.
+     */
+    static QStringList getNames();
+
+    /**
+     * @brief Extract each border's features on its own (default extractor).
+     * @param descriptors Descriptors of the four borders.
+     * @param image Tile's image.
+     */
+    static void extractBorders(TileDescriptor **descriptors, const QImage &image);
+
+    /**
+     * @brief Compute each distance with the descriptor's distance kernel
+     *        (default batch kernel).
+     * @param descriptor Descriptor of one border.
+     * @param others Descriptors of the opposite border.
+     * @param n Number of other descriptors.
+     * @param param Whether paramP and paramQ should be considered.
+     * @param distances Output, one distance per other descriptor.
+     */
+    static void computeDistances(TileDescriptor *descriptor, TileDescriptor **others, int n,
+                                 bool param, float *distances);
+};
+
+#endif // DESCRIPTORREGISTRY_H
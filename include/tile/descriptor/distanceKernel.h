@@ -0,0 +1,97 @@
+#ifndef DISTANCEKERNEL_H
+#define DISTANCEKERNEL_H
+
+#include <math.h>
+
+#include "tile/descriptor/tileDescriptor.h"
+
+/**
+ * @brief Exponents of the distance metrics with specialized kernels.
+ *        Descriptors pick their kernel once, from their parameters,
+ *        instead of calling powf for every pixel.
+ */
+class Exponent {
+public:
+    static const int ONE = 0;
+    static const int TWO = 1;
+    static const int HALF = 2;
+    static const int GENERIC = 3;
+
+    /**
+     * @brief Classify an exponent.
+     * @param e Exponent.
+     * @return Exponent class.
+     */
+    static int classify(float e) {
+        if (fabsf(e - 1.0f) < 0.000001f)
+            return ONE;
+        if (fabsf(e - 2.0f) < 0.000001f)
+            return TWO;
+        if (fabsf(e - 0.5f) < 0.000001f)
+            return HALF;
+        return GENERIC;
+    }
+
+    /**
+     * @brief Raise x to exponent e, of exponent class E.
+     * @param x
+     * @param e
+     * @return x^e.
+     */
+    template<int E> static inline float power(float x, float e);
+};
+
+template<> inline float Exponent::power<Exponent::ONE>(float x, float e) {
+    return x;
+}
+
+template<> inline float Exponent::power<Exponent::TWO>(float x, float e) {
+    return x * x;
+}
+
+template<> inline float Exponent::power<Exponent::HALF>(float x, float e) {
+    return sqrtf(x);
+}
+
+template<> inline float Exponent::power<Exponent::GENERIC>(float x, float e) {
+    return powf(x, e);
+}
+
+/**
+ * @brief Select descriptor D's kernel specialized on exponent P and exponent class q.
+ */
+template<class D, int P>
+TileDescriptor::DistanceKernel selectDistanceKernel(int q) {
+    switch (q) {
+    case Exponent::ONE:
+        return &D::template distance<P, Exponent::ONE>;
+    case Exponent::TWO:
+        return &D::template distance<P, Exponent::TWO>;
+    case Exponent::HALF:
+        return &D::template distance<P, Exponent::HALF>;
+    default:
+        return &D::template distance<P, Exponent::GENERIC>;
+    }
+}
+
+/**
+ * @brief Select descriptor D's kernel specialized on its exponents p and q.
+ * @param p Exponent p.
+ * @param q Exponent q.
+ * @return Distance kernel.
+ */
+template<class D>
+TileDescriptor::DistanceKernel selectDistanceKernel(float p, float q) {
+    switch (Exponent::classify(p)) {
+    case Exponent::ONE:
+        return selectDistanceKernel<D, Exponent::ONE>(Exponent::classify(q));
+    case Exponent::TWO:
+        return selectDistanceKernel<D, Exponent::TWO>(Exponent::classify(q));
+    case Exponent::HALF:
+        return selectDistanceKernel<D, Exponent::HALF>(Exponent::classify(q));
+    default:
+        return selectDistanceKernel<D, Exponent::GENERIC>(Exponent::classify(q));
+    }
+}
+
+#endif // DISTANCEKERNEL_H
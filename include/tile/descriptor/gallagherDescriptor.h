@@ -26,6 +26,14 @@ public:
      */
     void createFeatureVector(QImage image, int border);
 
+    /**
+     * @brief Create the feature vectors of a tile's four borders, and their
+     *        statistics, in a single pass over its pixels.
+     * @param descriptors Descriptors of the four borders, indexed by border.
+     * @param image Tile's image, with 32 bits per pixel.
+     */
+    static void extractFeatures(TileDescriptor **descriptors, const QImage &image);
+
     /**
      * @brief Compute distance between this descriptor's tile and another descriptor's tile.
      * @param otherDescriptor Other descriptor.
@@ -34,6 +42,48 @@ public:
      */
     float computeDistance(TileDescriptor *otherDescriptor, bool param=true);
 
+    /**
+     * @brief Get the distance kernel specialized on this descriptor's parameters.
+     * @param param Whether paramP and paramQ should be considered.
+     * @return Distance kernel.
+     */
+    DistanceKernel getDistanceKernel(bool param=true);
+
+    /**
+     * @brief Get the size of the border's statistics.
+     * @return State size, in bytes.
+     */
+    int getStateSize();
+
+    /**
+     * @brief Save the border's statistics.
+     * @param state Output, getStateSize() bytes.
+     */
+    void saveState(char *state);
+
+    /**
+     * @brief Load the border's statistics.
+     * @param state State saved by saveState.
+     */
+    void loadState(const char *state);
+
+    /**
+     * @brief Distance kernel, specialized on the exponent classes of P and Q.
+     * @param first Descriptor of the first tile's right (bottom) border.
+     * @param second Descriptor of the second tile's left (top) border.
+     * @return Computed distance.
+     */
+    template<int P, int Q> static float distance(TileDescriptor *first, TileDescriptor *second);
+
+    /**
+     * @brief Compute the Mahalanobis distance from one border to another, with
+     *        the first border's statistics, from their precomputed terms.
+     * @param a First border's descriptor.
+     * @param b Second border's descriptor.
+     * @return Computed distance.
+     */
+    static double mahalanobis(GallagherDescriptor *a, GallagherDescriptor *b);
+
     /**
      * @brief Get value in position (r,c) of the invertdd covariance matrix.
      * @param r
@@ -49,11 +99,24 @@ public:
      */
     float getMean(int c) { return mean[c]; }
 
+    /**
+     * Lines in the feature vector: the outer pixels, and the outer pixels
+     * centered, shifted by the mean and premultiplied by the inverse covariance.
+     */
+    static const int LINES = 2;
+
 private:
     /**
-     * Auxiliary variables.
+     * @brief Compute the gradients' mean and inverse covariance across the
+     *        border, and the distance terms that only depend on this border.
+     * @param inner Line of pixels next to the outer one, 3 floats per pixel.
      */
-    int dataExt, dataInt;
+    void computeStatistics(const float *inner);
+
+    /**
+     * Distance kernel for this descriptor's parameters.
+     */
+    DistanceKernel kernel;
 
     /**
      * 3x3 covariance that captures the relationship of the gradients
@@ -66,6 +129,22 @@ private:
        the two columns of the descriptor.
     */
     float mean[3];
+
+    /**
+     * Terms of the Mahalanobis distance that only depend on this border,
+     * for its pixels x centered on their average: the symmetric part of
+     * the inverse covariance, and the sum over the border of
+     * (x - center + mean)' invcov (x - center + mean).
+     */
+    double sinv[3][3];
+    double center[3];
+    double selfTerm;
+
+    /**
+     * Sums of the border's pixels x and of x x', for when it is the other border.
+     */
+    double sums[3];
+    double moments[3][3];
 };
 
 
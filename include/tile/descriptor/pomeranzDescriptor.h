@@ -26,6 +26,14 @@ public:
      */
     void createFeatureVector(QImage image, int border);
 
+    /**
+     * @brief Create the feature vectors of a tile's four borders in a single
+     *        pass over its pixels.
+     * @param descriptors Descriptors of the four borders, indexed by border.
+     * @param image Tile's image, with 32 bits per pixel.
+     */
+    static void extractFeatures(TileDescriptor **descriptors, const QImage &image);
+
     /**
      * @brief Compute distance between this descriptor and another descriptor.
      * @param otherDescriptor Other descriptor.
@@ -34,12 +42,36 @@ public:
      */
 	float computeDistance(TileDescriptor *otherDescriptor, bool param=true);
 
+    /**
+     * @brief Get the distance kernel specialized on this descriptor's parameters.
+     * @param param Whether paramP and paramQ should be considered.
+     * @return Distance kernel.
+     */
+    DistanceKernel getDistanceKernel(bool param=true);
+
+    /**
+     * @brief Distance kernel, specialized on the exponent classes of P and Q.
+     * @param first Descriptor of the first tile's right (bottom) border.
+     * @param second Descriptor of the second tile's left (top) border.
+     * @return Computed distance.
+     */
+    template<int P, int Q> static float distance(TileDescriptor *first, TileDescriptor *second);
+
+    /**
+     * Lines of pixels in the feature vector (outer and inner).
+     */
+    static const int LINES = 2;
+
 private:
     /**
-     * Auxiliary variables.
+     * @brief Convert the feature vector's pixels from RGB to Lab, in place.
+     */
+    void convertToLab();
+
+    /**
+     * Distance kernel for this descriptor's parameters.
      */
-	int dataExt, dataInt;
-	int nx2;
+    DistanceKernel kernel;
 };
 
 #endif // POMERANZDESC_H
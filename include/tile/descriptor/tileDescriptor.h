@@ -13,9 +13,32 @@ public:
      * @param paramP Parameter P of the descriptor.
      * @param paramQ Parameter Q of the descriptor.
      */
-	TileDescriptor(float paramP, float paramQ): tileDescriptor(NULL), paramP(paramP), paramQ(paramQ) {
+	TileDescriptor(float paramP, float paramQ): tileDescriptor(NULL), ownsBuffer(false),
+			paramP(paramP), paramQ(paramQ), size(0) {
 	}
 	virtual ~TileDescriptor() {
+		if (ownsBuffer)
+			qFreeAligned(tileDescriptor);
+	}
+
+	/**
+     * @brief Set the buffer the feature vector is stored in (e.g. a slice of an
+     *        arena shared by all tiles), instead of allocating one.
+     * @param buffer 16-byte aligned buffer of getBufferSize() floats.
+     */
+	void setBuffer(float *buffer) {
+		tileDescriptor = buffer;
+	}
+
+	/**
+     * @brief Get the number of floats to store lines of pixels, 3 per pixel,
+     *        padded so consecutive buffers stay 16-byte aligned.
+     * @param lines Number of lines.
+     * @param size Number of pixels of each line.
+     * @return Buffer size, in floats.
+     */
+	static int getBufferSize(int lines, int size) {
+		return (3 * lines * size + 3) & ~3;
 	}
 
 	/**
@@ -35,27 +58,158 @@ public:
 		return 0.0;
 	}
 
+	/**
+     * Distance kernel between the descriptors of two neighboring borders:
+     * first's right (bottom) border and second's left (top) border.
+     */
+	typedef float (*DistanceKernel)(TileDescriptor *first, TileDescriptor *second);
+
+	/**
+     * @brief Get the distance kernel of this descriptor's type, specialized
+     *        on its parameters, to compute many distances without dispatching
+     *        each one through computeDistance.
+     * @param param Whether paramP and paramQ should be considered.
+     * @return Distance kernel.
+     */
+	virtual DistanceKernel getDistanceKernel(bool param=true) = 0;
+
+	/**
+     * @brief Get the size of the state this descriptor keeps besides its
+     *        feature vector (e.g. statistics of its border).
+     * @return State size, in bytes.
+     */
+	virtual int getStateSize() {
+		return 0;
+	}
+
+	/**
+     * @brief Save the state this descriptor keeps besides its feature vector.
+     * @param state Output, getStateSize() bytes.
+     */
+	virtual void saveState(char *state) {
+	}
+
+	/**
+     * @brief Load the state this descriptor keeps besides its feature vector.
+     * @param state State saved by saveState.
+     */
+	virtual void loadState(const char *state) {
+	}
+
+	/**
+     * @brief Restore this descriptor from a feature vector and state saved
+     *        earlier, without reading any pixels. Call setBuffer first.
+     * @param border Border of the tile.
+     * @param width Tile's width.
+     * @param height Tile's height.
+     * @param state State saved by saveState.
+     */
+	void restore(int border, int width, int height, const char *state);
+
 	/**
      * @brief Get tile descriptor.
-     * @return Feature vector for this descriptor's tile.
+     * @return Feature vector for this descriptor's tile, 3 contiguous floats per pixel.
      */
-	float **getTileDescriptor() {
+	float *getTileDescriptor() {
 		return tileDescriptor;
 	}
 	int getSize() {
 		return size;
 	}
-	QImage getImage() {
-		return image;
+	int getBorder() {
+		return border;
+	}
+	float getParamP() {
+		return paramP;
+	}
+	float getParamQ() {
+		return paramQ;
+	}
+
+	/**
+     * Outer and inner lines of pixels of a tile's four borders, indexed
+     * by border, 3 floats per pixel.
+     */
+	struct BorderStrips {
+		float *outer[4];
+		float *inner[4];
+	};
+
+	/**
+     * @brief Read the outer and inner lines of a tile's four borders in a
+     *        single pass over the image's rows.
+     * @param image Image with 32 bits per pixel (Format_RGB32 or Format_ARGB32),
+     *        at least 2 pixels wide and high.
+     * @param strips Output buffers.
+     */
+	static void readBorders(const QImage &image, BorderStrips &strips);
+
+	/**
+     * @brief Read a line of pixels straight from the image data, as floats
+     *        (red, green, blue for each pixel).
+     * @param image Image with 32 bits per pixel (Format_RGB32 or Format_ARGB32).
+     * @param index Column or row to read.
+     * @param column Whether to read a column (by row stride) instead of a row.
+     * @param rgb Output buffer, 3 floats per pixel of the line.
+     */
+	static void readLine(const QImage &image, int index, bool column, float *rgb) {
+		const QRgb *pixel;
+		if (column) {
+			const uchar *bits = image.constBits() + index * sizeof(QRgb);
+			int stride = image.bytesPerLine();
+			for (int i = 0; i < image.height(); i++, rgb += 3) {
+				pixel = (const QRgb*) (bits + i * stride);
+				rgb[0] = (float) qRed(*pixel);
+				rgb[1] = (float) qGreen(*pixel);
+				rgb[2] = (float) qBlue(*pixel);
+			}
+		} else {
+			pixel = (const QRgb*) image.constScanLine(index);
+			for (int i = 0; i < image.width(); i++, pixel++, rgb += 3) {
+				rgb[0] = (float) qRed(*pixel);
+				rgb[1] = (float) qGreen(*pixel);
+				rgb[2] = (float) qBlue(*pixel);
+			}
+		}
 	}
 	
 private:
 
 protected:
-	float **tileDescriptor;
+	/**
+     * @brief Allocate the feature vector, unless a buffer was set.
+     * @param lines Number of lines of pixels in the feature vector.
+     */
+	void allocateBuffer(int lines) {
+		if (tileDescriptor != NULL)
+			return;
+		tileDescriptor = (float*) qMallocAligned(getBufferSize(lines, size) * sizeof(float), 16);
+		ownsBuffer = true;
+	}
+
+	/**
+     * @brief Set the border this descriptor describes, and allocate its feature vector.
+     * @param border Border of the tile.
+     * @param width Tile's width.
+     * @param height Tile's height.
+     * @param lines Number of lines of pixels in the feature vector.
+     */
+	void setBorder(int border, int width, int height, int lines);
+
+	/**
+     * @brief Get the outer and inner lines of pixels of a border.
+     * @param border Border of the tile.
+     * @param width Tile's width.
+     * @param height Tile's height.
+     * @param outer Outer line, a column for the right and left borders, a row otherwise.
+     * @param inner Line next to the outer one.
+     */
+	static void getLines(int border, int width, int height, int &outer, int &inner);
+
+	float *tileDescriptor;
+	bool ownsBuffer;
 	float paramP, paramQ;
 	int size, border;
-	QImage image;
 };
 
 #endif // TILEDESC_H
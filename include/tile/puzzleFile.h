@@ -0,0 +1,163 @@
+#ifndef PUZZLEFILE_H
+#define PUZZLEFILE_H
+
+#include <QtGui>
+
+class TiledImage;
+
+/**
+ * Default size, in pixels, of the longest side of the thumbnails stored in a puzzle file.
+ */
+#define PUZZLE_THUMBNAIL_SIZE 32
+
+/**
+ * Alignment, in bytes, of each section of a puzzle file.
+ */
+#define PUZZLE_ALIGNMENT 64
+
+/**
+ * @brief Puzzle file: a binary container holding a puzzle's size, its tiles'
+ *        features and descriptor states, and optionally thumbnails of its
+ *        tiles. Sections are aligned and stored in native byte order, so the
+ *        file is mapped into memory and used as is, without decoding.
+ */
+class PuzzleFile {
+public:
+    /**
+     * Struct to store the header at the start of a puzzle file.
+     */
+    struct header {
+        char magic[8];
+        qint32 version;
+        qint32 ncols, nrows;
+        qint32 tileWidth, tileHeight;
+        qint32 thumbnailWidth, thumbnailHeight;
+        // Floats of features per tile, and bytes of state per border
+        qint32 featureSize, stateSize;
+        float paramP, paramQ;
+        char descriptor[32];
+        quint64 featuresOffset, statesOffset, thumbnailsOffset;
+    };
+
+    static const qint32 VERSION = 1;
+
+    /**
+     * @brief Puzzle file constructor. Maps the file into memory and checks its header.
+     * @param fileName Puzzle file.
+     */
+    PuzzleFile(QString fileName);
+    ~PuzzleFile();
+
+    /**
+     * @brief Save a tiled image's tiles, in their current order, with the
+     *        features of the descriptor set for them.
+     * @param fileName Puzzle file.
+     * @param tiledImage Tiled image, after TiledImage::setDescriptor.
+     * @param thumbnailSize Size of the longest side of the thumbnails (0 for no thumbnails).
+     */
+    static void save(QString fileName, TiledImage *tiledImage, int thumbnailSize);
+
+    /**
+     * @brief Get number of columns of the puzzle.
+     * @return Number of columns of the puzzle.
+     */
+    int getNCols();
+
+    /**
+     * @brief Get number of rows of the puzzle.
+     * @return Number of rows of the puzzle.
+     */
+    int getNRows();
+
+    /**
+     * @brief Get the tiles' width.
+     * @return Tiles' width.
+     */
+    int getTileWidth();
+
+    /**
+     * @brief Get the tiles' height.
+     * @return Tiles' height.
+     */
+    int getTileHeight();
+
+    /**
+     * @brief Get the name of the descriptor the features were computed with.
+     * @return Descriptor name.
+     */
+    QString getDescriptor();
+
+    /**
+     * @brief Get the descriptor's parameter P.
+     * @return Parameter P.
+     */
+    float getParamP();
+
+    /**
+     * @brief Get the descriptor's parameter Q.
+     * @return Parameter Q.
+     */
+    float getParamQ();
+
+    /**
+     * @brief Get the number of floats holding a tile's features.
+     * @return Feature size, in floats.
+     */
+    int getFeatureSize();
+
+    /**
+     * @brief Get the number of bytes of a border's descriptor state.
+     * @return State size, in bytes.
+     */
+    int getStateSize();
+
+    /**
+     * @brief Get the features of every tile, getFeatureSize() floats per
+     *        tile, in the mapped file (read-only).
+     * @return Features.
+     */
+    const float *getFeatures();
+
+    /**
+     * @brief Get the descriptor states of every tile, four borders of
+     *        getStateSize() bytes per tile, in the mapped file.
+     * @return Descriptor states.
+     */
+    const char *getStates();
+
+    /**
+     * @brief Get a read-only image over the thumbnails in the mapped file,
+     *        one below the other in tile order. It must not outlive this puzzle file.
+     * @return Thumbnails, or a null image if the file has none.
+     */
+    QImage getThumbnails();
+
+    /**
+     * @brief Get the thumbnails' width.
+     * @return Thumbnails' width (0 if the file has none).
+     */
+    int getThumbnailWidth();
+
+    /**
+     * @brief Get the thumbnails' height.
+     * @return Thumbnails' height (0 if the file has none).
+     */
+    int getThumbnailHeight();
+
+private:
+    /**
+     * @brief Round an offset up to the sections' alignment.
+     * @param offset Offset, in bytes.
+     * @return Aligned offset.
+     */
+    static quint64 align(quint64 offset);
+
+    /**
+     * Mapped file.
+     */
+    QFile file;
+    uchar *data;
+    const header *info;
+};
+
+#endif // PUZZLEFILE_H
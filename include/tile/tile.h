@@ -4,6 +4,7 @@
 #include <QtGui>
 
 #include "tile/descriptor/tileDescriptor.h"
+#include "tile/descriptor/descriptorRegistry.h"
 
 /**
  * @brief A tile from a tiled image.
@@ -25,10 +26,34 @@ public:
     static const int T = 3; // top border
 
     /**
-     * @brief Set tile image.
-     * @param image Image for tile.
+     * @brief Set tile image, as a view of a region of a source image:
+     *        the source's pixels are shared, not copied.
+     * @param source Source image, with 32 bits per pixel (Format_RGB32 or Format_ARGB32).
+     * @param rect Region of the source covered by the tile.
      */
-    void setImage(QImage image);
+    void setImage(const QImage &source, const QRect &rect);
+
+    /**
+     * @brief Set tile image, as a region of an image file that is only
+     *        decoded when the tile's pixels are needed.
+     * @param file Image file, whose format must support decoding a region.
+     * @param rect Region of the image covered by the tile.
+     */
+    void setImage(const QString &file, const QRect &rect);
+
+    /**
+     * @brief Set tile size only, for a tile without an image whose
+     *        descriptors are restored from a puzzle file.
+     * @param width Tile's width.
+     * @param height Tile's height.
+     */
+    void setSize(int width, int height);
+
+    /**
+     * @brief Set a thumbnail, shown scaled to the tile's size when the tile has no image.
+     * @param thumbnail Thumbnail, with 32 bits per pixel.
+     */
+    void setThumbnail(const QImage &thumbnail);
     
     /**
      * @brief Compute distance between this tile and another tile.
@@ -40,11 +65,47 @@ public:
 
     /**
      * @brief Create descriptor for the four borders of this tile.
-     * @param desc Descriptor name.
+     * @param desc Registered descriptor.
      * @param paramP Descriptor's parameter P.
      * @param paramP Descriptor's parameter Q.
+     * @param features Buffer for the four borders' features, of getFeatureSize() floats
+     *        and 16-byte aligned, or NULL for each descriptor to allocate its own.
+     */
+    void createDescriptors(const DescriptorRegistry::entry *desc, float paramP, float paramQ, float *features = NULL);
+
+    /**
+     * @brief Create descriptor for the four borders of this tile, from the given pixels.
+     * @param desc Registered descriptor.
+     * @param paramP Descriptor's parameter P.
+     * @param paramP Descriptor's parameter Q.
+     * @param features Buffer for the four borders' features, or NULL.
+     * @param pixels This tile's pixels, with 32 bits per pixel.
+     */
+    void createDescriptors(const DescriptorRegistry::entry *desc, float paramP, float paramQ,
+                           float *features, const QImage &pixels);
+
+    /**
+     * @brief Restore descriptor for the four borders of this tile from
+     *        features and states saved earlier, without reading any pixels.
+     *        Call setSize or setImage first.
+     * @param desc Registered descriptor.
+     * @param paramP Descriptor's parameter P.
+     * @param paramP Descriptor's parameter Q.
+     * @param features The four borders' features, of getFeatureSize() floats
+     *        and 16-byte aligned. They are used in place, not copied.
+     * @param states The four borders' descriptor states.
+     */
+    void restoreDescriptors(const DescriptorRegistry::entry *desc, float paramP, float paramQ,
+                            const float *features, const char *states);
+
+    /**
+     * @brief Get the number of floats holding a tile's features for the four borders.
+     * @param desc Registered descriptor.
+     * @param width Tile's width.
+     * @param height Tile's height.
+     * @return Feature buffer size, in floats.
      */
-    void createDescriptors(QString desc, float paramP, float paramQ);
+    static int getFeatureSize(const DescriptorRegistry::entry *desc, int width, int height);
 
     /**
      * @brief Get this tile's descriptors.
@@ -52,6 +113,12 @@ public:
      */
     TileDescriptor **getDescriptors();
 
+    /**
+     * @brief Get the registered descriptor this tile's descriptors were created with.
+     * @return Registered descriptor, or NULL if there are no descriptors yet.
+     */
+    const DescriptorRegistry::entry *getDescriptorType();
+
     /**
      * @brief Get this tile's height.
      * @return This tile's height.
@@ -65,21 +132,65 @@ public:
     int getWidth();
 
     /**
-     * @brief Get this tile's image.
+     * @brief Get this tile's image, copying its pixels out of the source image.
+     *        A tile without an image returns its thumbnail, scaled to its size.
      * @return This tile's image.
      */
     QImage getImage();
+
+    /**
+     * @brief Get a read-only image over this tile's pixels in the source
+     *        image, without copying them. It must not outlive the tile.
+     *        Tiles of an image file decode their region instead, and tiles
+     *        without an image return their scaled thumbnail.
+     * @return View of this tile's image.
+     */
+    QImage getView();
+
+    /**
+     * @brief Get a read-only image over a region of a source image, without copying it.
+     * @param source Image with 32 bits per pixel.
+     * @param rect Region of the image.
+     * @return View of the region. It must not outlive the source.
+     */
+    static QImage getView(const QImage &source, const QRect &rect);
     
 private:
     /**
-     * This tile's image.
+     * @brief Create the descriptors of the four borders, replacing any
+     *        previous ones, with their features in the given buffer.
+     * @param desc Registered descriptor.
+     * @param paramP Descriptor's parameter P.
+     * @param paramP Descriptor's parameter Q.
+     * @param features Buffer for the four borders' features, or NULL.
+     */
+    void allocateDescriptors(const DescriptorRegistry::entry *desc, float paramP, float paramQ,
+                             float *features);
+
+    /**
+     * @brief Check whether this tile has an image, in memory or in a file.
+     * @return Whether this tile has an image.
+     */
+    bool hasImage();
+
+    /**
+     * Source image, or image file not kept in memory, and the region of it
+     * that is this tile's image.
+     */
+    QImage source;
+    QString file;
+    QRect rect;
+
+    /**
+     * Thumbnail of a tile without an image.
      */
-    QImage image;
+    QImage thumbnail;
 
     /**
      * Descriptor for the four borders of this tile.
      */
     TileDescriptor **descriptors;
+    const DescriptorRegistry::entry *descriptorType;
 };
 
 #endif /* TILE_H_ */
@@ -4,9 +4,22 @@
 #include <QtGui>
 
 #include "tile/tile.h"
+#include "tile/puzzleFile.h"
 
 using namespace std;
 
+/**
+ * Largest number of pixels decoded at once when streaming an image file.
+ */
+#ifndef STREAM_BAND_PIXELS
+#define STREAM_BAND_PIXELS (1 << 25)
+#endif
+
+/**
+ * Extension of the manifest files listing the tile images of a pre-cut puzzle.
+ */
+#define TILE_MANIFEST_SUFFIX "txt"
+
 /**
  * @brief Tiled image.
  */
@@ -19,16 +32,79 @@ public:
      * @param nrows Number of rows of the tiled image.
      */
     TiledImage(QImage *image, int ncols, int nrows);
+
+    /**
+     * @brief Tiled image constructor for streaming: only the image's size is
+     *        read now. Its pixels are decoded band by band, each band dropped
+     *        once its tiles' features are computed, and a tile's region is
+     *        decoded again only when its pixels are needed (e.g. rendering).
+     *        The image's format must support decoding a region (see canStream).
+     * @param imageFile Image file to be tiled.
+     * @param ncols Number of colums of the tiled image.
+     * @param nrows Number of rows of the tiled image.
+     */
+    TiledImage(QString imageFile, int ncols, int nrows);
+
+    /**
+     * @brief Tiled image constructor for pre-cut tiles: the tile images are
+     *        decoded concurrently, and must all have the same size.
+     * @param tileFiles Tile image files, in row-major order of the solved puzzle.
+     * @param ncols Number of colums of the tiled image.
+     * @param nrows Number of rows of the tiled image.
+     */
+    TiledImage(QStringList tileFiles, int ncols, int nrows);
+
+    /**
+     * @brief Tiled image constructor for a puzzle file: the tiles' descriptors
+     *        are restored from the features in the mapped file, and no pixels
+     *        are decoded. Tiles show the file's thumbnails, if any.
+     * @param puzzle Puzzle file, owned by the tiled image from now on.
+     */
+    TiledImage(PuzzleFile *puzzle);
+
+    /**
+     * @brief List the tile images of a pre-cut puzzle.
+     * @param path Directory of tile images, sorted by name, or manifest
+     *        file listing one tile image per line (relative to the manifest's directory).
+     * @return Tile image files.
+     */
+    static QStringList listTileFiles(QString path);
+
+    /**
+     * @brief Check whether a path is a pre-cut puzzle: a directory of tile
+     *        images, or a manifest file ending in TILE_MANIFEST_SUFFIX.
+     * @param path Path to check.
+     * @return True if the path is a pre-cut puzzle.
+     */
+    static bool isPreCut(QString path);
+
+    /**
+     * @brief Check whether an image file can be streamed, i.e. whether its
+     *        Qt plugin decodes a region without decoding the whole image
+     *        (e.g. JPEG, but not PNG in Qt 4).
+     * @param imageFile Image file.
+     * @return True if the image file can be streamed.
+     */
+    static bool canStream(QString imageFile);
     ~TiledImage();
 
     /**
-     * @brief Get tiled image's tiles.
+     * @brief Get tiled image's tiles, in their original order. Tiles are
+     *        never moved: permutations only change which tile is at each position.
      * @return This tililed image's tiles.
      */
     Tile *getTiles();
-    
+
     /**
-     * @brief Set descriptor for the tiles.
+     * @brief Get the tile at a position of the current permutation.
+     * @param position Position, in row-major order.
+     * @return Tile at the position.
+     */
+    Tile *getTile(int position);
+
+    /**
+     * @brief Set descriptor for the tiles. The descriptor of a puzzle file
+     *        is fixed when it is converted, so only that one is accepted.
      * @param desc Descriptor name.
      * @param paramP Descriptor's parameter P.
      * @param paramQ Descriptor's parameter Q.
@@ -36,16 +112,41 @@ public:
     void setDescriptor(QString desc, double paramP, double paramQ);
 
     /**
-     * @brief Permute tiles.
-     * @param perm Permutation for the tiles or NULL for random permutation.
+     * @brief Permute tiles, composing the permutation with the current one.
+     *        The previous permutation is kept, to be undone.
+     * @param perm Permutation for the tiles (position whose tile moves to each
+     *        position; the caller keeps it) or NULL for random permutation.
      */
     void permutTiles(int *perm=NULL);
 
+    /**
+     * @brief Undo the last permutation. Only one level is kept: undoing
+     *        twice in a row, or after nothing was permuted, does nothing.
+     * @return Whether there was a permutation to undo.
+     */
+    bool undoPermutation();
+
     /**
      * @brief Compute puzzle metrics with current permutation.
      */
     void computeMetrics();
 
+    /**
+     * @brief Get the direct accuracy computed by the last computeMetrics:
+     *        percentage of tiles at their original position.
+     * @return Direct accuracy, in percent, or -1 if not computed for the
+     *         current permutation.
+     */
+    double getDirectAccuracy();
+
+    /**
+     * @brief Get the neighbor accuracy computed by the last computeMetrics:
+     *        percentage of tile borders next to their original neighbor.
+     * @return Neighbor accuracy, in percent, or -1 if not computed for the
+     *         current permutation.
+     */
+    double getNeighborAccuracy();
+
     /**
      * @brief Get number of columns of tiled image.
      * @return Number of columns of the tiled image.
@@ -59,6 +160,31 @@ public:
     int getNRows();
 
 private:
+    /**
+     * @brief Set the tiled image's size, and allocate its tiles.
+     * @param width Image's width.
+     * @param height Image's height.
+     */
+    void setSize(int width, int height);
+
+    /**
+     * @brief Decode a band of rows of tiles from the image file.
+     * @param first First row of tiles.
+     * @param rows Number of rows of tiles.
+     * @return Band, with 32 bits per pixel.
+     */
+    QImage readBand(int first, int rows);
+
+    /**
+     * Image file streamed from (empty when the image is kept in memory).
+     */
+    QString imageFile;
+
+    /**
+     * Puzzle file the tiles' features are mapped from (NULL if there is none).
+     */
+    PuzzleFile *puzzle;
+
     /**
      * @brief Information about tiled image's tiles.
      */
@@ -68,9 +194,25 @@ private:
 
     /**
      * Translation between tiles positions before 
-     * and after permutation.
+     * and after permutation: original index of the tile at each position.
      * */ 
     int *tileTranslation;
+
+    /**
+     * Translation before the last permutation, to undo it.
+     * */
+    int *permutBuffer;
+    bool canUndo;
+
+    /**
+     * Accuracy of the current permutation, in percent (-1 until computed).
+     */
+    double directAccuracy, neighborAccuracy;
+
+    /**
+     * Arena holding the features of every tile's descriptors.
+     */
+    float *features;
 };
 
 #endif // TILEDIMAGE_H
@@ -0,0 +1,95 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QtGui>
+
+/**
+ * Trace zones: PSQP_TRACE_SCOPE("name") times the rest of the enclosing
+ * scope while a trace is recording. Zones compile to nothing unless PSQP
+ * is built with DEFINES += PSQP_TRACE.
+ */
+#ifdef PSQP_TRACE
+#define PSQP_TRACE_CONCAT2(a, b) a##b
+#define PSQP_TRACE_CONCAT(a, b) PSQP_TRACE_CONCAT2(a, b)
+#define PSQP_TRACE_SCOPE(name) Trace::Scope PSQP_TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define PSQP_TRACE_SCOPE(name)
+#endif
+
+/**
+ * @brief Trace of the zones run by each thread, exported as a Chrome trace
+ *        (JSON, viewed in chrome://tracing or Perfetto).
+ */
+class Trace {
+public:
+    /**
+     * Struct to store one run of a zone.
+     */
+    struct event {
+        const char *name;
+        qint64 start, duration;
+    };
+
+    /**
+     * @brief Scoped zone: records an event from its construction to its destruction.
+     */
+    class Scope {
+    public:
+        /**
+         * @brief Scope constructor.
+         * @param name Zone name, a string literal.
+         */
+        Scope(const char *name): name(name), start(-1) {
+            if (recording)
+                start = now();
+        }
+        ~Scope() {
+            if (start >= 0)
+                record(name, start, now() - start);
+        }
+
+    private:
+        const char *name;
+        qint64 start;
+    };
+
+    /**
+     * @brief Start recording, dropping any previous events.
+     */
+    static void start();
+
+    /**
+     * @brief Stop recording, and write the events of every thread
+     *        to a Chrome trace file.
+     * @param traceFile Path to trace file.
+     */
+    static void write(QString traceFile);
+
+    /**
+     * @brief Check whether trace zones were compiled in.
+     * @return Whether PSQP was built with PSQP_TRACE.
+     */
+    static bool isCompiledIn();
+
+private:
+    /**
+     * @brief Get the time since recording started.
+     * @return Time, in nanoseconds.
+     */
+    static qint64 now();
+
+    /**
+     * @brief Record an event in the calling thread's buffer.
+     * @param name Zone name.
+     * @param start Start time, in nanoseconds.
+     * @param duration Duration, in nanoseconds.
+     */
+    static void record(const char *name, qint64 start, qint64 duration);
+
+    /**
+     * Whether a trace is recording.
+     */
+    static volatile bool recording;
+};
+
+#endif // TRACE_H
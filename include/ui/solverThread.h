@@ -0,0 +1,59 @@
+#ifndef SOLVERTHREAD_H
+#define SOLVERTHREAD_H
+
+#include <QtGui>
+#include "psqp.h"
+
+/**
+ * @brief Worker thread running the solver or the local search refinement,
+ *        so the window stays responsive while a puzzle is solved.
+ */
+class SolverThread: public QThread {
+    Q_OBJECT
+
+public:
+    /**
+     * @brief SolverThread constructor.
+     * @param psqp Puzzle solver object.
+     * @param parent Parent object.
+     */
+    SolverThread(PSQP *psqp, QObject *parent = 0);
+
+    /**
+     * Tasks.
+     */
+    static const int SOLVE = 0;
+    static const int REFINE = 1;
+
+    /**
+     * @brief Set the task of the next run.
+     * @param task SOLVE or REFINE.
+     * @param timeBudget Refinement's time budget in milliseconds.
+     */
+    void setTask(int task, int timeBudget = 0);
+
+    /**
+     * @brief Get the task of the last run.
+     * @return SOLVE or REFINE.
+     */
+    int getTask();
+
+protected:
+    /**
+     * @brief Run the task.
+     */
+    void run();
+
+private:
+    /**
+     * Puzzle solver object.
+     */
+    PSQP *psqp;
+
+    /**
+     * Task, and refinement's time budget.
+     */
+    int task, timeBudget;
+};
+
+#endif // SOLVERTHREAD_H
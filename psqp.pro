@@ -11,6 +11,8 @@ QMAKE_CXXFLAGS_RELEASE -= -O1
 QMAKE_CXXFLAGS_RELEASE -= -O2
 QMAKE_CXXFLAGS_RELEASE += -O3
 QMAKE_CXXFLAGS_WARN_ON += -Wno-unused-parameter
+# Uncomment to compile in the trace zones used by --trace
+# DEFINES += PSQP_TRACE
 
 QT += core \
     gui \
@@ -26,6 +28,9 @@ OBJECTS_DIR += ./obj
 
 SOURCES = $$files(*.cpp, true)
 HEADERS = $$files(*.h, true)
+# The benchmark and the tests are separate targets (bench/bench.pro, test/test.pro)
+SOURCES -= $$files(bench/*.cpp, true)
+SOURCES -= $$files(test/*.cpp, true)
 
 FORMS += ../ui/src/mainWindow.ui
 RESOURCES += psqp.qrc
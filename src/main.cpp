@@ -3,6 +3,7 @@
 #include <iostream>
 
 #include "mainWindow.h"
+#include "trace.h"
 
 using namespace std;
 
@@ -43,30 +44,124 @@ int main(int argc, char *argv[]) {
     }
 
     // Run in cli
-    if (argc < 7) {
-        std::cout << "Usage: PSQP <input image> <number of columns> "
-                                 "<number of rows> <descriptor>[Pomeranz|Gallagher] "
-                                 "<parameter p> <parameter q>" << '\n';
+    QStringList descriptors = psqp->getDescriptorNames();
+    // A puzzle file holds the puzzle size and descriptor itself
+    bool isPuzzleFile = (argc >= 2) && QString(argv[1]).endsWith(".psqp");
+    if (argc < 7 && !isPuzzleFile) {
+        std::cout << "Usage: PSQP <input image|tile directory|tile manifest> <number of columns> "
+                                 "<number of rows> <descriptor>["
+                  << qPrintable(descriptors.join("|")) << "] "
+                                 "<parameter p> <parameter q> "
+                                 "[--solver <GradientDescent|FrankWolfe|Greedy>] "
+                                 "[--window <size>] [--overlap <size>] [--sparse] "
+                                 "[--greedy-init <weight>] [--refine <milliseconds>] "
+                                 "[--time-budget <milliseconds>] [--max-iterations <n>] "
+                                 "[--stream] [--convert <puzzle file>] "
+                                 "[--thumbnail-size <pixels>] [--report <file>] [--trace <file>]" << '\n';
+        std::cout << "       PSQP <puzzle file.psqp> [options]" << '\n';
         return -1;
     }
 
     // Read arguments
     QString inputImage = argv[1];
-    int ncols = atoi(argv[2]);
-    int nrows = atoi(argv[3]);
-    QString desc = argv[4];
-    int paramP = atof(argv[5]);
-    int paramQ = atof(argv[6]);
+    int ncols = 0, nrows = 0;
+    QString desc;
+    float paramP = 0.0, paramQ = 0.0;
+    if (!isPuzzleFile) {
+        ncols = atoi(argv[2]);
+        nrows = atoi(argv[3]);
+        desc = argv[4];
+        paramP = atof(argv[5]);
+        paramQ = atof(argv[6]);
+        if (!descriptors.contains(desc)) {
+            std::cout << "Unknown descriptor " << argv[4] << '\n';
+            return -1;
+        }
+    }
+
+    // Read options
+    int windowSize = 0, windowOverlap = 0;
+    bool sparse = false, streaming = false;
+    float greedyWeight = 0.0;
+    int refineBudget = -1;
+    int timeBudget = 0, iterationBudget = 0;
+    QString backend = "GradientDescent";
+    QString convertFile, reportFile, traceFile;
+    int thumbnailSize = PUZZLE_THUMBNAIL_SIZE;
+    for (int i = isPuzzleFile ? 2 : 7; i < argc; i++) {
+        QString option = argv[i];
+        if (option == "--solver" && i + 1 < argc)
+            backend = argv[++i];
+        else if (option == "--window" && i + 1 < argc)
+            windowSize = atoi(argv[++i]);
+        else if (option == "--overlap" && i + 1 < argc)
+            windowOverlap = atoi(argv[++i]);
+        else if (option == "--sparse")
+            sparse = true;
+        else if (option == "--stream")
+            streaming = true;
+        else if (option == "--greedy-init" && i + 1 < argc)
+            greedyWeight = atof(argv[++i]);
+        else if (option == "--refine" && i + 1 < argc)
+            refineBudget = atoi(argv[++i]);
+        else if (option == "--time-budget" && i + 1 < argc)
+            timeBudget = atoi(argv[++i]);
+        else if (option == "--max-iterations" && i + 1 < argc)
+            iterationBudget = atoi(argv[++i]);
+        else if (option == "--convert" && i + 1 < argc)
+            convertFile = argv[++i];
+        else if (option == "--thumbnail-size" && i + 1 < argc)
+            thumbnailSize = atoi(argv[++i]);
+        else if (option == "--report" && i + 1 < argc)
+            reportFile = argv[++i];
+        else if (option == "--trace" && i + 1 < argc)
+            traceFile = argv[++i];
+        else
+            std::cout << "Unknown option " << argv[i] << '\n';
+    }
+
+    if (streaming && !isPuzzleFile && TiledImage::isPreCut(inputImage)) {
+        std::cout << "--stream does not apply to pre-cut tiles" << '\n';
+        return -1;
+    }
 
     // Set puzzle parameters and run PSQP
-    psqp->setImage(inputImage);
-    psqp->setPuzzleSize(ncols, nrows);
-    psqp->setDescriptor(desc, paramP, paramQ);
+    psqp->setWindows(windowSize, windowOverlap);
+    psqp->setSparse(sparse);
+    psqp->setGreedyInit(greedyWeight);
+    psqp->setBudget(timeBudget, iterationBudget);
+    psqp->setSolver(backend);
+    if (!traceFile.isEmpty()) {
+        if (!Trace::isCompiledIn())
+            std::cout << "Trace zones are not compiled in, rebuild with DEFINES += PSQP_TRACE" << '\n';
+        Trace::start();
+    }
+    if (isPuzzleFile) {
+        psqp->loadPuzzle(inputImage);
+    } else {
+        psqp->setStreaming(streaming);
+        psqp->setImage(inputImage);
+        psqp->setPuzzleSize(ncols, nrows);
+        psqp->setDescriptor(desc, paramP, paramQ);
+    }
+    // Convert the solved puzzle, before its tiles are shuffled
+    if (!convertFile.isEmpty()) {
+        psqp->savePuzzle(convertFile, thumbnailSize);
+        if (!traceFile.isEmpty())
+            Trace::write(traceFile);
+        delete psqp;
+        return 0;
+    }
     psqp->getTiledImage()->permutTiles();
     psqp->runSolver();
+    qDebug() << "Cost: " << psqp->getCost() << (psqp->hasConverged() ? "(converged)" : "(budget expired)");
     psqp->optimizeShift();
-    psqp->optimizeShift();
-    psqp->optimizeShift();
+    if (refineBudget >= 0)
+        psqp->refine(refineBudget);
+    if (!reportFile.isEmpty())
+        psqp->writeReport(reportFile);
+    if (!traceFile.isEmpty())
+        Trace::write(traceFile);
     delete psqp;
     return 0;
 }
@@ -0,0 +1,218 @@
+#include <float.h>
+
+#include "optimization/assignment.h"
+
+/**
+ * Rows of a dense cost matrix.
+ * */
+struct denseRows {
+    float **cost;
+    const float *row(int i) {
+        return cost[i];
+    }
+};
+
+/**
+ * Rows of a sparse cost matrix, expanded one at a time into a buffer.
+ * */
+struct sparseRows {
+    Assignment::sparseRow *rows;
+    float *buffer;
+    int n, current;
+    const float *row(int i) {
+        if (i != current) {
+            for (int j = 0; j < n; j++)
+                buffer[j] = rows[i].defaultCost;
+            for (int k = 0; k < rows[i].size; k++)
+                buffer[rows[i].cols[k]] = rows[i].cost[k];
+            current = i;
+        }
+        return buffer;
+    }
+};
+
+template <class Rows>
+static int *hungarian(Rows &cost, int n) {
+    /**
+     * Rows and columns are 1-indexed; column 0 is a dummy column holding
+     * the row being inserted. u and v are the dual potentials, match[j] is
+     * the row assigned to column j and way[j] the previous column in the
+     * augmenting path.
+     * */
+    double *u = new double[n + 1];
+    double *v = new double[n + 1];
+    double *minv = new double[n + 1];
+    int *match = new int[n + 1];
+    int *way = new int[n + 1];
+    bool *used = new bool[n + 1];
+
+    for (int j = 0; j <= n; j++) {
+        u[j] = v[j] = 0.0;
+        match[j] = way[j] = 0;
+    }
+
+    int i0, j0, j1;
+    double delta, cur;
+    const float *row;
+    for (int i = 1; i <= n; i++) {
+        match[0] = i;
+        j0 = 0;
+        for (int j = 0; j <= n; j++) {
+            minv[j] = DBL_MAX;
+            used[j] = false;
+        }
+        // Grow the shortest augmenting path from row i
+        do {
+            used[j0] = true;
+            i0 = match[j0];
+            row = cost.row(i0 - 1);
+            delta = DBL_MAX;
+            j1 = 0;
+            for (int j = 1; j <= n; j++) {
+                if (used[j])
+                    continue;
+                cur = row[j - 1] - u[i0] - v[j];
+                if (cur < minv[j]) {
+                    minv[j] = cur;
+                    way[j] = j0;
+                }
+                if (minv[j] < delta) {
+                    delta = minv[j];
+                    j1 = j;
+                }
+            }
+            for (int j = 0; j <= n; j++) {
+                if (used[j]) {
+                    u[match[j]] += delta;
+                    v[j] -= delta;
+                } else
+                    minv[j] -= delta;
+            }
+            j0 = j1;
+        } while (match[j0] != 0);
+
+        // Flip the path
+        do {
+            j1 = way[j0];
+            match[j0] = match[j1];
+            j0 = j1;
+        } while (j0 != 0);
+    }
+
+    int *assignment = new int[n];
+    for (int j = 1; j <= n; j++)
+        assignment[match[j] - 1] = j - 1;
+
+    delete[] u;
+    delete[] v;
+    delete[] minv;
+    delete[] match;
+    delete[] way;
+    delete[] used;
+
+    return assignment;
+}
+
+int *Assignment::solve(float **cost, int n) {
+    denseRows rows;
+    rows.cost = cost;
+    return hungarian(rows, n);
+}
+
+int *Assignment::solve(sparseRow *rows, int n) {
+    sparseRows sparse;
+    sparse.rows = rows;
+    sparse.buffer = new float[n];
+    sparse.n = n;
+    sparse.current = -1;
+    int *assignment = hungarian(sparse, n);
+    delete[] sparse.buffer;
+    return assignment;
+}
+
+/**
+ * Row of a greedy assignment and the cost of its cheapest column.
+ * */
+struct greedyRow {
+    int row;
+    float cost;
+};
+
+/**
+ * Compare rows by the cost of their cheapest column, cheapest first.
+ * */
+int greedyRowsComparison(const void *a, const void *b) {
+    const greedyRow *ra = (const greedyRow *) a;
+    const greedyRow *rb = (const greedyRow *) b;
+    if (ra->cost < rb->cost)
+        return -1;
+    if (ra->cost > rb->cost)
+        return 1;
+    return ra->row - rb->row;
+}
+
+int *Assignment::solveGreedy(float **cost, int n) {
+    greedyRow *order = new greedyRow[n];
+    for (int i = 0; i < n; i++) {
+        order[i].row = i;
+        order[i].cost = FLT_MAX;
+        for (int j = 0; j < n; j++)
+            order[i].cost = qMin(order[i].cost, cost[i][j]);
+    }
+    qsort(order, n, sizeof(greedyRow), greedyRowsComparison);
+
+    int *assignment = new int[n];
+    bool *taken = (bool*) calloc(n, sizeof(bool));
+    int i, best;
+    for (int k = 0; k < n; k++) {
+        i = order[k].row;
+        best = -1;
+        for (int j = 0; j < n; j++)
+            if (!taken[j] && (best == -1 || cost[i][j] < cost[i][best]))
+                best = j;
+        assignment[i] = best;
+        taken[best] = true;
+    }
+
+    free(taken);
+    delete[] order;
+    return assignment;
+}
+
+int *Assignment::solveGreedy(sparseRow *rows, int n) {
+    greedyRow *order = new greedyRow[n];
+    for (int i = 0; i < n; i++) {
+        order[i].row = i;
+        order[i].cost = rows[i].defaultCost;
+        for (int k = 0; k < rows[i].size; k++)
+            order[i].cost = qMin(order[i].cost, rows[i].cost[k]);
+    }
+    qsort(order, n, sizeof(greedyRow), greedyRowsComparison);
+
+    // Rows without a free column cheaper than their default take the first free column
+    int *assignment = new int[n];
+    bool *taken = (bool*) calloc(n, sizeof(bool));
+    int i, best, nextFree = 0;
+    for (int k = 0; k < n; k++) {
+        i = order[k].row;
+        best = -1;
+        for (int c = 0; c < rows[i].size; c++) {
+            if (taken[rows[i].cols[c]] || rows[i].cost[c] > rows[i].defaultCost)
+                continue;
+            if (best == -1 || rows[i].cost[c] < rows[i].cost[best])
+                best = c;
+        }
+        if (best != -1) {
+            assignment[i] = rows[i].cols[best];
+        } else {
+            while (taken[nextFree])
+                nextFree++;
+            assignment[i] = nextFree;
+        }
+        taken[assignment[i]] = true;
+    }
+
+    free(taken);
+    delete[] order;
+    return assignment;
+}
@@ -0,0 +1,190 @@
+#include <float.h>
+
+#include "optimization/frankWolfe.h"
+#include "optimization/assignment.h"
+#include "trace.h"
+
+FrankWolfe::FrankWolfe(int ncols, int nrows) {
+    this->ncols = ncols;
+    this->nrows = nrows;
+    ntiles = ncols * nrows;
+}
+
+FrankWolfe::~FrankWolfe() {
+}
+
+int *FrankWolfe::solve(float **hCompat, float **vCompat, float **pInit) {
+    PSQP_TRACE_SCOPE("FrankWolfe::solve");
+    /**
+     * F(p) = sum over edges (i,j) of p_i' * C * p_j, with C the compatibility
+     * matrix across the edge, is bilinear in each edge, so along a direction
+     * d = s - p it is the quadratic F(p + g*d) = F(p) + g*b + g^2*a, with
+     *   b = <grad, s> - <grad, p>
+     *   a = F(s) - <grad, s> + F(p), and F(p) = <grad, p> / 2,
+     * which gives the exact line search without another pass over C.
+     * */
+    this->hCompat = hCompat;
+    this->vCompat = vCompat;
+    p = pInit;
+
+    grad = new float*[ntiles];
+    for (int i = 0; i < ntiles; i++)
+        grad[i] = new float[ntiles];
+
+    int *solution = new int[ntiles];
+    for (int i = 0; i < ntiles; i++)
+        solution[i] = i;
+    double bestCost = DBL_MAX;
+    double gp, gs, fp, fs, a, b, gamma;
+    int iterations = 0;
+    bool canceled = false, outOfTime = false;
+    converged = false;
+    QElapsedTimer budgetTimer;
+    budgetTimer.start();
+
+    for (iterations = 0; iterations < FW_MAX_ITERATIONS; iterations++) {
+        PSQP_TRACE_SCOPE("FrankWolfe::iteration");
+        if (monitor != NULL && monitor->isCanceled()) {
+            qDebug() << "Frank-Wolfe canceled.";
+            canceled = true;
+            break;
+        }
+        if (budgetExpired(budgetTimer, iterations)) {
+            qDebug() << "Frank-Wolfe budget expired.";
+            outOfTime = timeBudget > 0 && budgetTimer.elapsed() >= timeBudget;
+            break;
+        }
+        computeGradient();
+
+        // Linear subproblem: permutation s minimizing <grad, s>
+        int *s = Assignment::solve(grad, ntiles);
+
+        gp = gs = 0.0;
+        for (int i = 0; i < ntiles; i++) {
+            gs += grad[i][s[i]];
+            for (int k = 0; k < ntiles; k++)
+                gp += grad[i][k] * p[i][k];
+        }
+        fp = gp / 2.0;
+        fs = computeCost(s);
+        if (monitor != NULL)
+            monitor->reportProgress(computeProgress(budgetTimer, iterations), FW_PROGRESS_STEPS,
+                                    iterations, fp);
+
+        // Every vertex is a feasible solution: keep the best one
+        if (fs < bestCost) {
+            bestCost = fs;
+            memcpy(solution, s, ntiles * sizeof(int));
+        }
+
+        b = gs - gp;
+        a = fs - gs + fp;
+        if (-b <= FW_GAP_THRESHOLD * fabs(fp)) {
+            delete[] s;
+            converged = true;
+            break;
+        }
+
+        if (a > 0.0)
+            gamma = qMin(1.0, -b / (2.0 * a));
+        else
+            gamma = (a + b < 0.0) ? 1.0 : 0.0;
+
+        for (int i = 0; i < ntiles; i++) {
+            for (int k = 0; k < ntiles; k++)
+                p[i][k] *= (1.0 - gamma);
+            p[i][s[i]] += gamma;
+        }
+        delete[] s;
+
+        if (gamma == 0.0) {
+            converged = true;
+            break;
+        }
+    }
+    qDebug() << "ITER: " << iterations;
+    iterationCount = iterations;
+
+    // Round the final permutation matrix, maximizing the assigned values
+    // (a canceled solution is discarded), greedily once the time budget is gone
+    if (!canceled) {
+        for (int i = 0; i < ntiles; i++)
+            for (int k = 0; k < ntiles; k++)
+                grad[i][k] = -p[i][k];
+        int *rounded = outOfTime ? Assignment::solveGreedy(grad, ntiles)
+                                                   : Assignment::solve(grad, ntiles);
+        if (computeCost(rounded) < bestCost)
+            memcpy(solution, rounded, ntiles * sizeof(int));
+        delete[] rounded;
+    }
+
+    for (int i = 0; i < ntiles; i++)
+        delete[] grad[i];
+    delete[] grad;
+
+    return solution;
+}
+
+int FrankWolfe::computeProgress(QElapsedTimer &timer, int iterations) {
+    // Fraction of the iteration limit or of the time budget, whichever is larger
+    int limit = FW_MAX_ITERATIONS;
+    if (iterationBudget > 0)
+        limit = qMin(limit, iterationBudget);
+    double fraction = iterations / (double) limit;
+    if (timeBudget > 0)
+        fraction = qMax(fraction, timer.elapsed() / (double) timeBudget);
+    return qMin(FW_PROGRESS_STEPS, (int) (fraction * FW_PROGRESS_STEPS));
+}
+
+void FrankWolfe::computeGradient() {
+    /**
+     * For each horizontal edge (i,j)
+     *   grad_i += H  * p_j;
+     *   grad_j += H' * p_i;
+     * and the same for vertical edges with V.
+     * */
+    for (int i = 0; i < ntiles; i++)
+        for (int k = 0; k < ntiles; k++)
+            grad[i][k] = 0.0;
+
+    int i, j;
+    double sum1, sum2;
+    for (int r = 0; r < nrows; r++) {
+        for (int c = 0; c < ncols; c++) {
+            i = c + r * ncols;
+            // horizontal edge (i,i+1) and vertical edge (i,i+ncols)
+            for (int e = 0; e < 2; e++) {
+                if (e == 0 && c + 1 >= ncols)
+                    continue;
+                if (e == 1 && r + 1 >= nrows)
+                    continue;
+                j = (e == 0) ? i + 1 : i + ncols;
+                float **compat = (e == 0) ? hCompat : vCompat;
+                for (int k = 0; k < ntiles; k++) {
+                    sum1 = sum2 = 0.0;
+                    for (int h = 0; h < ntiles; h++) {
+                        sum1 += compat[k][h] * p[j][h];
+                        sum2 += compat[h][k] * p[i][h];
+                    }
+                    grad[i][k] += sum1;
+                    grad[j][k] += sum2;
+                }
+            }
+        }
+    }
+}
+
+double FrankWolfe::computeCost(int *perm) {
+    double cost = 0.0;
+    int i;
+    for (int r = 0; r < nrows; r++) {
+        for (int c = 0; c < ncols; c++) {
+            i = c + r * ncols;
+            if (c + 1 < ncols)
+                cost += hCompat[perm[i]][perm[i + 1]];
+            if (r + 1 < nrows)
+                cost += vCompat[perm[i]][perm[i + ncols]];
+        }
+    }
+    return cost;
+}
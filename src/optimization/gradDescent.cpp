@@ -1,6 +1,9 @@
 #include <gmp.h>
 
 #include "optimization/gradientDescent.h"
+#include "optimization/assignment.h"
+#include "optimization/greedyPlacer.h"
+#include "trace.h"
 
 using namespace std;
 
@@ -12,12 +15,29 @@ GradientDescent::GradientDescent(Tile *tiles, int ncols, int nrows) {
     ntiles = ncols * nrows;
     ntiles2 = ntiles * ntiles;
     ntilesx2 = 2 * ntiles;
+
+    sparse = false;
+    rows = NULL;
+    colSum = NULL;
+    colCount = NULL;
+    prior = NULL;
+    priorWeight = 0.0;
+}
+
+void GradientDescent::setSparse(bool sparse) {
+    this->sparse = sparse;
+}
+
+void GradientDescent::setPrior(int *prior, float weight) {
+    this->prior = prior;
+    this->priorWeight = weight;
 }
 
 GradientDescent::~GradientDescent() {
 }
 
 int *GradientDescent::solve(float**hCompat, float **vCompat, float **pInit) {
+    PSQP_TRACE_SCOPE("GradientDescent::solve");
     p = pInit;
     step = 0.0;
     this->clampCount = 0;
@@ -25,70 +45,244 @@ int *GradientDescent::solve(float**hCompat, float **vCompat, float **pInit) {
     this->vCompat = vCompat;
     this->stopCriteria = false;
     int iterations = 0;
-
-    dF = new float*[ntiles];
-    zeroed = new bool*[ntiles];
-    for (int i = 0; i < ntiles; i++) {
-        dF[i] = (float*) calloc(ntiles, sizeof(float));
-        zeroed[i] = (bool*) calloc(ntiles, sizeof(bool));
+    bool endgame = false, canceled = false, outOfTime = false;
+    converged = false;
+    QElapsedTimer budgetTimer;
+    budgetTimer.start();
+    int lapTiles = (int) (LAP_THRESHOLD * ntiles);
+
+    clampedTile.resize(ntiles); // clamped tiles
+    clampedPosition.resize(ntiles); // clamped positions
+    nwords = clampedPosition.getNWords();
+    int *greedyPrior = NULL;
+    if (sparse) {
+        // Candidates must be restricted: without a prior, place the tiles greedily
+        if (pInit == NULL && prior == NULL) {
+            GreedyPlacer placer(NULL, ncols, nrows);
+            greedyPrior = placer.solve(hCompat, vCompat, NULL);
+            prior = greedyPrior;
+        }
+        initSparse(pInit);
+        colSum = (float*) calloc(ntiles, sizeof(float));
+        colCount = (int*) calloc(ntiles, sizeof(int));
+    } else {
+        dF = new float*[ntiles];
+        zeroed = new BitSet[ntiles];
+        for (int i = 0; i < ntiles; i++) {
+            dF[i] = (float*) calloc(ntiles, sizeof(float));
+            zeroed[i].resize(ntiles);
+        }
     }
     solution = new int[ntiles];
-    clampedTile = (bool*) calloc(ntiles, sizeof(bool)); // clamped tiles
-    clampedPosition = (bool*) calloc(ntiles, sizeof(bool)); // clamped positions
+
+    // A uniform sparse start takes the prior in, like a restart
+    if (sparse && pInit == NULL && prior != NULL)
+        restartSparsePermutation();
 
     /* ---- INITIAL TIME ---- */
-    clock_t s1, f1;
-    double time;
-    s1 = clock();
+    // Wall time: CPU time would add up the threads' time
+    QElapsedTimer wallTimer;
+    wallTimer.start();
     /* ---------------------- */
 
     // Start iterating until stop criteria is reached
+    bool report;
+    double cost = 0.0;
     while (!stopCriteria) {
-        computeDescentVector();
-        constrainDescentVector();
-        updatePermutation();
+        PSQP_TRACE_SCOPE("GradientDescent::iteration");
+        if (monitor != NULL && monitor->isCanceled()) {
+            qDebug() << "Gradient descent canceled.";
+            canceled = true;
+            break;
+        }
+        if (budgetExpired(budgetTimer, iterations)) {
+            qDebug() << "Gradient descent budget expired.";
+            outOfTime = timeBudget > 0 && budgetTimer.elapsed() >= timeBudget;
+            break;
+        }
+        report = (monitor != NULL) && (iterations % GD_PROGRESS_INTERVAL == 0);
+
+        if (sparse) {
+            computeSparseDescentVector();
+            if (report)
+                cost = computeRelaxedCost();
+            constrainSparseDescentVector();
+            updateSparsePermutation();
+        } else {
+            computeDescentVector();
+            if (report)
+                cost = computeRelaxedCost();
+            constrainDescentVector();
+            updatePermutation();
+        }
 
+        if (report)
+            monitor->reportProgress(clampCount, ntiles, iterations, cost);
         iterations++;
+
+        // Few tiles left: hand them over to the linear assignment
+        if (!stopCriteria && ntiles - clampCount <= lapTiles)
+            endgame = true;
+        if (endgame)
+            break;
     }
     /* ---- FINAL TIME ---- */
-    f1 = clock();
-    time = (double(f1) - double(s1)) / CLOCKS_PER_SEC;
-    qDebug() << "TOTAL TIME " << time;
-    qDebug() << "ITER: " << (iterations-1);
+    qDebug() << "TOTAL TIME " << wallTimer.elapsed() / 1000.0;
+    qDebug() << "ITER: " << iterations;
     /* -------------------- */
 
-    double maxCost = 0.0;
-    int maxTile = -1;
+    converged = stopCriteria || endgame;
+    iterationCount = iterations;
+
+    if (canceled) {
+        // The solution is discarded: give the free tiles the free positions, in order
+        int j = 0;
+        for (int i = 0; i < ntiles; i++) {
+            if (clampedTile.test(i))
+                continue;
+            while (clampedPosition.test(j))
+                j++;
+            solution[i] = j++;
+        }
+    } else {
+        // Round the remaining fractional tiles, greedily once the time budget is gone
+        finishAssignment(endgame, outOfTime);
+    }
+
+    if (sparse) {
+        for (int i = 0; i < ntiles; i++) {
+            free(rows[i].pos);
+            free(rows[i].p);
+            free(rows[i].dF);
+        }
+        delete[] rows;
+        free(colSum);
+        free(colCount);
+        rows = NULL;
+        if (greedyPrior != NULL) {
+            delete[] greedyPrior;
+            prior = NULL;
+        }
+    } else {
+        for (int i = 0; i < ntiles; i++)
+            free(dF[i]);
+        delete[] dF;
+        delete[] zeroed;
+    }
+
+    return solution;
+}
+
+double GradientDescent::computeRelaxedCost() {
+    double cost = 0.0;
     for (int i = 0; i < ntiles; i++) {
-        if (!clampedTile[i]) {
-            maxCost = -1.0;
-            maxTile = -1;
-            for (int j = 0; j < ntiles; j++) {
-                if (!clampedPosition[j])
-                    if (p[i][j] > maxCost) {
-                        maxCost = p[i][j];
-                        maxTile = j;
-                    }
+        if (clampedTile.test(i))
+            continue;
+        if (sparse) {
+            for (int a = 0; a < rows[i].size; a++)
+                cost += rows[i].p[a] * rows[i].dF[a];
+        } else {
+            for (int j = 0; j < ntiles; j++)
+                if (!clampedPosition.test(j))
+                    cost += p[i][j] * dF[i][j];
+        }
+    }
+    return cost / 2.0;
+}
+
+void GradientDescent::finishAssignment(bool linearize, bool bounded) {
+    PSQP_TRACE_SCOPE("GradientDescent::finishAssignment");
+    int nfree = ntiles - clampCount;
+    if (nfree == 0)
+        return;
+
+    if (linearize) {
+        if (sparse)
+            computeSparseDescentVector();
+        else
+            computeDescentVector();
+    }
+
+    // Free tiles and positions, and each position's index among the free ones
+    int *freeTile = new int[nfree];
+    int *freePosition = new int[nfree];
+    int *positionIndex = new int[ntiles];
+    int a = 0, b = 0;
+    for (int k = 0; k < ntiles; k++) {
+        if (!clampedTile.test(k))
+            freeTile[a++] = k;
+        if (!clampedPosition.test(k)) {
+            positionIndex[k] = b;
+            freePosition[b++] = k;
+        } else
+            positionIndex[k] = -1;
+    }
+
+    qDebug() << "Assigning " << nfree << " tiles" << (bounded ? "(greedy)" : "");
+    int *assignment;
+    int i, j;
+    if (sparse) {
+        /**
+         * Descent vector entries lie in [-4, 0] (at most four neighbors with
+         * compatibilities in [-1, 0]), so positions that are no longer
+         * candidates cost 1 in the linearized cost, and 0 otherwise.
+         * Only the candidates are stored.
+         * */
+        Assignment::sparseRow *cost = new Assignment::sparseRow[nfree];
+        for (a = 0; a < nfree; a++) {
+            i = freeTile[a];
+            cost[a].cols = new int[qMax(1, rows[i].size)];
+            cost[a].cost = new float[qMax(1, rows[i].size)];
+            cost[a].size = 0;
+            cost[a].defaultCost = linearize ? 1.0 : 0.0;
+            for (int c = 0; c < rows[i].size; c++) {
+                b = positionIndex[rows[i].pos[c]];
+                if (b == -1)
+                    continue;
+                cost[a].cols[cost[a].size] = b;
+                cost[a].cost[cost[a].size] = linearize ? rows[i].dF[c] : -rows[i].p[c];
+                cost[a].size++;
             }
-            clampedTile[i] = 1;
-            clampedPosition[maxTile] = 1;
-            solution[i] = maxTile;
         }
+        assignment = bounded ? Assignment::solveGreedy(cost, nfree) : Assignment::solve(cost, nfree);
+        for (a = 0; a < nfree; a++) {
+            delete[] cost[a].cols;
+            delete[] cost[a].cost;
+        }
+        delete[] cost;
+    } else {
+        float **cost = new float*[nfree];
+        for (a = 0; a < nfree; a++) {
+            i = freeTile[a];
+            cost[a] = new float[nfree];
+            for (b = 0; b < nfree; b++) {
+                j = freePosition[b];
+                cost[a][b] = linearize ? dF[i][j] : -p[i][j];
+            }
+        }
+        assignment = bounded ? Assignment::solveGreedy(cost, nfree) : Assignment::solve(cost, nfree);
+        for (a = 0; a < nfree; a++)
+            delete[] cost[a];
+        delete[] cost;
     }
 
-    for (int i = 0; i < ntiles; i++) {
-        free(dF[i]);
-        free(zeroed[i]);
+    for (a = 0; a < nfree; a++) {
+        i = freeTile[a];
+        j = freePosition[assignment[a]];
+        clampedTile.set(i);
+        clampedPosition.set(j);
+        solution[i] = j;
+        clampCount++;
     }
-    delete[] dF;
-    delete[] zeroed;
-    free(clampedTile);
-    free(clampedPosition);
 
-    return solution;
+    delete[] assignment;
+    delete[] freeTile;
+    delete[] freePosition;
+    delete[] positionIndex;
 }
 
 void GradientDescent::computeDescentVector() {
+    PSQP_TRACE_SCOPE("GradientDescent::computeDescentVector");
     /**
      *  F(p) = p'*A*p
      * dF = - (A + A') * p = (2*A)*p
@@ -111,13 +305,12 @@ void GradientDescent::computeDescentVector() {
 
     // clear accumulator
     for (int i = 0; i < ntiles; i++) {
-        if (!clampedTile[i])
+        if (!clampedTile.test(i))
             for (int j = 0; j < ntiles; j++)
                 dF[i][j] = 0.0;
     }
 
     int i, j;
-    double sum;
     // add horizontal cost contributions
     for (int r = 0; r < nrows; r++) {
         for (int c = 0; c + 1 < ncols; c++) {
@@ -125,28 +318,11 @@ void GradientDescent::computeDescentVector() {
             i = c + r * ncols;
             j = i + 1;
             // dF_i -= H  * p_j;
-            if (!clampedTile[i])
-                for (int k = 0; k < ntiles; k++) {
-                    if (!clampedPosition[k]) {
-                        sum = 0.0;
-                        // dF_i[k] = inner product of k-th row of H and p_j
-                        for (int h = 0; h < ntiles; h++)
-                            sum += hCompat[k][h] * p[j][h];
-                        dF[i][k] += sum;
-                    }
-                }
+            if (!clampedTile.test(i))
+                addContribution(i, j, hCompat, false);
             // dF_j -= H' * p_i;
-            if (!clampedTile[j]) {
-                for (int k = 0; k < ntiles; k++) {
-                    if (!clampedPosition[k]) {
-                        sum = 0.0;
-                        // dF_j[k] = inner product of k-th column of H and p_i
-                        for (int h = 0; h < ntiles; h++)
-                            sum += hCompat[h][k] * p[i][h];
-                        dF[j][k] += sum;
-                    }
-                }
-            }
+            if (!clampedTile.test(j))
+                addContribution(j, i, hCompat, true);
         }
     }
 
@@ -157,63 +333,94 @@ void GradientDescent::computeDescentVector() {
             i = c + r * ncols;
             j = i + ncols;
             // dF_i -= V  * p_j;
-            if (!clampedTile[i]) {
-                for (int k = 0; k < ntiles; k++) {
-                    if (!clampedPosition[k]) {
-                        sum = 0.0;
-                        // dF_i[k] = inner product of k-th row of V and p_j
-                        for (int h = 0; h < ntiles; h++)
-                            sum += vCompat[k][h] * p[j][h];
-                        dF[i][k] += sum;
-                    }
-                }
-            }
+            if (!clampedTile.test(i))
+                addContribution(i, j, vCompat, false);
             // dF_j -= V' * p_i;
-            if (!clampedTile[j]) {
-                for (int k = 0; k < ntiles; k++) {
-                    if (!clampedPosition[k]) {
-                        sum = 0.0;
-                        // dF_j[k] = inner product of k-th column of V and p_i
-                        for (int h = 0; h < ntiles; h++)
-                            sum += vCompat[h][k] * p[i][h];
-                        dF[j][k] += sum;
-                    }
-                }
+            if (!clampedTile.test(j))
+                addContribution(j, i, vCompat, true);
+        }
+    }
+}
+
+void GradientDescent::addContribution(int i, int j, float **compat, bool transposed) {
+    double sum;
+    int k;
+    quint64 bits;
+    // only positions not yet clamped, 64 at a time
+    for (int w = 0; w < nwords; w++) {
+        bits = ~clampedPosition.word(w) & clampedPosition.mask(w);
+        while (bits) {
+            k = (w << 6) + BitSet::lowestBit(bits);
+            bits &= bits - 1;
+            sum = 0.0;
+            if (transposed) {
+                // dF_i[k] = inner product of k-th column of compat and p_j
+                for (int h = 0; h < ntiles; h++)
+                    sum += compat[h][k] * p[j][h];
+            } else {
+                // dF_i[k] = inner product of k-th row of compat and p_j
+                for (int h = 0; h < ntiles; h++)
+                    sum += compat[k][h] * p[j][h];
             }
+            dF[i][k] += sum;
         }
     }
 }
 
 void GradientDescent::restartPermutation() {
     float p0 = 1.0 / (float) (ntiles - clampCount);
+    float pBlend = (1.0 - priorWeight) * p0;
+    bool blend;
+    int j;
+    quint64 bits;
     for (int i = 0; i < ntiles; i++) {
-        if (!clampedTile[i]) {
-            for (int j = 0; j < ntiles; j++) {
-                if (!clampedPosition[j]) {
-                    p[i][j] = p0;
-                }
+        if (clampedTile.test(i))
+            continue;
+        // blend the prior in if its position is still free
+        blend = (prior != NULL) && !clampedPosition.test(prior[i]);
+        for (int w = 0; w < nwords; w++) {
+            bits = ~clampedPosition.word(w) & clampedPosition.mask(w);
+            while (bits) {
+                j = (w << 6) + BitSet::lowestBit(bits);
+                bits &= bits - 1;
+                p[i][j] = blend ? pBlend : p0;
             }
         }
+        if (blend)
+            p[i][prior[i]] += priorWeight;
     }
 }
 
 void GradientDescent::constrainDescentVector() {
+    PSQP_TRACE_SCOPE("GradientDescent::constrainDescentVector");
     int i, j;
     float lambda;
     bool isZero = true;
+    quint64 bits;
 
     float naux = 1.0 / (float) (ntiles - clampCount);
     // apply row constraints
-    for (j = 0; j < ntiles; j++) {
-        lambda = 0.0;
-        if (!clampedPosition[j]) {
-            for (i = 0; i < ntiles; i++) {
-                if (!clampedTile[i])
+    quint64 positions, tiles;
+    for (int v = 0; v < nwords; v++) {
+        positions = ~clampedPosition.word(v) & clampedPosition.mask(v);
+        while (positions) {
+            j = (v << 6) + BitSet::lowestBit(positions);
+            positions &= positions - 1;
+            lambda = 0.0f;
+            for (int w = 0; w < nwords; w++) {
+                tiles = ~clampedTile.word(w) & clampedTile.mask(w);
+                while (tiles) {
+                    i = (w << 6) + BitSet::lowestBit(tiles);
+                    tiles &= tiles - 1;
                     lambda += dF[i][j];
+                }
             }
             lambda *= naux;
-            for (i = 0; i < ntiles; i++) {
-                if (!clampedTile[i]) {
+            for (int w = 0; w < nwords; w++) {
+                tiles = ~clampedTile.word(w) & clampedTile.mask(w);
+                while (tiles) {
+                    i = (w << 6) + BitSet::lowestBit(tiles);
+                    tiles &= tiles - 1;
                     dF[i][j] -= lambda;
                 }
             }
@@ -223,13 +430,21 @@ void GradientDescent::constrainDescentVector() {
     // apply column constraints
     for (j = 0; j < ntiles; j++) {
         lambda = 0.0f;
-        if (!clampedTile[j]) {
-            for (i = 0; i < ntiles; i++)
-                if (!clampedPosition[i])
+        if (!clampedTile.test(j)) {
+            for (int w = 0; w < nwords; w++) {
+                bits = ~clampedPosition.word(w) & clampedPosition.mask(w);
+                while (bits) {
+                    i = (w << 6) + BitSet::lowestBit(bits);
+                    bits &= bits - 1;
                     lambda += dF[j][i];
+                }
+            }
             lambda *= naux;
-            for (i = 0; i < ntiles; i++) {
-                if (!clampedPosition[i]) {
+            for (int w = 0; w < nwords; w++) {
+                bits = ~clampedPosition.word(w) & clampedPosition.mask(w);
+                while (bits) {
+                    i = (w << 6) + BitSet::lowestBit(bits);
+                    bits &= bits - 1;
                     dF[j][i] -= lambda;
                     if (dF[j][i] > MIN_THRESHOLD)
                         isZero = false;
@@ -243,6 +458,7 @@ void GradientDescent::constrainDescentVector() {
 }
 
 void GradientDescent::updatePermutation() {
+    PSQP_TRACE_SCOPE("GradientDescent::updatePermutation");
     // p = p - step*dF;
 
     if (stopCriteria)
@@ -251,10 +467,16 @@ void GradientDescent::updatePermutation() {
     step = computeStep();
 
     float aux;
+    int j;
+    quint64 bits;
     for (int i = 0; i < ntiles; i++) {
-        if (!clampedTile[i]) {
-            for (int j = 0; j < ntiles; j++) {
-                if ((!clampedPosition[j]) || (!zeroed[i][j])) {
+        if (!clampedTile.test(i)) {
+            // entries whose position is not clamped or that are not zeroed
+            for (int w = 0; w < nwords; w++) {
+                bits = ~(clampedPosition.word(w) & zeroed[i].word(w)) & clampedPosition.mask(w);
+                while (bits) {
+                    j = (w << 6) + BitSet::lowestBit(bits);
+                    bits &= bits - 1;
                     aux = step * dF[i][j];
                     p[i][j] -= aux;
                 }
@@ -264,27 +486,31 @@ void GradientDescent::updatePermutation() {
 
     bool clamp = false;
     for (int i = 0; i < ntiles; i++) {
-        if (!clampedTile[i]) {
-            for (int j = 0; j < ntiles; j++) {
-                if (!clampedPosition[j]) {
-                    if (p[i][j] < MIN_THRESHOLD) {
-                        p[i][j] = 0.0;
-                        zeroed[i][j] = true;
-                    } else if (p[i][j] > MAX_THRESHOLD) {
-                        p[i][j] = 1.0;
-                        clampedTile[i] = true;
-                        clampedPosition[j] = true;
-                        clampCount++;
-                        solution[i] = j;
-                        clamp = true;
-                        qDebug() << "CLAMP: " << i << " " << j;
-                        for (int k = 0; k < ntiles; k++) {
-                            if (k != j) {
-                                p[i][k] = 0.0;
-                            }
-                            if (k != i) {
-                                p[k][j] = 0.0;
-                            }
+        if (clampedTile.test(i))
+            continue;
+        for (int w = 0; w < nwords; w++) {
+            // re-read the word, as clamping inside it changes it
+            bits = ~clampedPosition.word(w) & clampedPosition.mask(w);
+            while (bits && !clampedTile.test(i)) {
+                j = (w << 6) + BitSet::lowestBit(bits);
+                bits &= bits - 1;
+                if (p[i][j] < MIN_THRESHOLD) {
+                    p[i][j] = 0.0;
+                    zeroed[i].set(j);
+                } else if (p[i][j] > MAX_THRESHOLD) {
+                    p[i][j] = 1.0;
+                    clampedTile.set(i);
+                    clampedPosition.set(j);
+                    clampCount++;
+                    solution[i] = j;
+                    clamp = true;
+                    qDebug() << "CLAMP: " << i << " " << j;
+                    for (int k = 0; k < ntiles; k++) {
+                        if (k != j) {
+                            p[i][k] = 0.0;
+                        }
+                        if (k != i) {
+                            p[k][j] = 0.0;
                         }
                     }
                 }
@@ -316,6 +542,7 @@ double GradientDescent::computeStep() {
 
     mpf_t a, b, x, step, aux, aux2;
     int i = 0, j = 0, pos;
+    quint64 bits;
 
     mpf_init(a);
     mpf_init_set_d(b, 0.5);
@@ -330,11 +557,15 @@ double GradientDescent::computeStep() {
         doBreak = false;
         mpf_add(x, a, b);
         mpf_div_ui(x, x, 2);
-        for (i = 0; i < ntiles; i++) {
-            if (!clampedTile[i]) {
-                for (j = 0; j < ntiles; j++) {
-                    if ((clampedPosition[j]) || (zeroed[i][j]))
-                        continue;
+        for (i = 0; i < ntiles && !doBreak; i++) {
+            if (clampedTile.test(i))
+                continue;
+            // skip clamped positions and zeroed entries, 64 at a time
+            for (int w = 0; w < nwords && !doBreak; w++) {
+                bits = ~(clampedPosition.word(w) | zeroed[i].word(w)) & clampedPosition.mask(w);
+                while (bits) {
+                    j = (w << 6) + BitSet::lowestBit(bits);
+                    bits &= bits - 1;
                     mpf_set_d(aux, dF[i][j]);
                     mpf_mul(aux2, aux, x);
                     mpf_set_d(aux, p[i][j]);
@@ -348,8 +579,6 @@ double GradientDescent::computeStep() {
                         break;
                     }
                 }
-                if (doBreak)
-                    break;
             }
         }
         if (doBreak) {
@@ -372,3 +601,361 @@ double GradientDescent::computeStep() {
 
     return finalStep;
 }
+
+void GradientDescent::initSparse(float **pInit) {
+    rows = new candidates[ntiles];
+    for (int i = 0; i < ntiles; i++) {
+        rows[i].pos = NULL;
+        rows[i].p = NULL;
+        rows[i].dF = NULL;
+        rows[i].size = 0;
+        rows[i].capacity = 0;
+    }
+
+    // Nonzero entries of the initial permutation matrix
+    if (pInit != NULL) {
+        for (int i = 0; i < ntiles; i++)
+            for (int j = 0; j < ntiles; j++)
+                if (pInit[i][j] >= MIN_THRESHOLD)
+                    appendCandidate(rows[i], j, pInit[i][j]);
+        return;
+    }
+
+    // The prior's position, and the best matches of its neighbors' positions
+    int c, r;
+    for (int i = 0; i < ntiles; i++) {
+        c = i % ncols;
+        r = i / ncols;
+        appendCandidate(rows[i], prior[i], 0.0);
+        if (c > 0)
+            addMatches(rows[i], prior[i - 1], hCompat, true);
+        if (c + 1 < ncols)
+            addMatches(rows[i], prior[i + 1], hCompat, false);
+        if (r > 0)
+            addMatches(rows[i], prior[i - ncols], vCompat, true);
+        if (r + 1 < nrows)
+            addMatches(rows[i], prior[i + ncols], vCompat, false);
+        for (int a = 0; a < rows[i].size; a++)
+            rows[i].p[a] = 1.0 / (float) rows[i].size;
+    }
+}
+
+void GradientDescent::appendCandidate(candidates &row, int pos, float p) {
+    if (row.size == row.capacity) {
+        row.capacity = qMax(4, 2 * row.capacity);
+        row.pos = (int*) realloc(row.pos, row.capacity * sizeof(int));
+        row.p = (float*) realloc(row.p, row.capacity * sizeof(float));
+        row.dF = (float*) realloc(row.dF, row.capacity * sizeof(float));
+    }
+    row.pos[row.size] = pos;
+    row.p[row.size] = p;
+    row.dF[row.size] = 0.0;
+    row.size++;
+}
+
+void GradientDescent::addMatches(candidates &row, int pos, float **compat, bool transposed) {
+    // Best (lowest) compatibilities, kept sorted by insertion
+    int best[SPARSE_MATCHES];
+    float bestValue[SPARSE_MATCHES];
+    int nbest = 0, b;
+    float value;
+    for (int k = 0; k < ntiles; k++) {
+        if (k == pos || clampedPosition.test(k))
+            continue;
+        value = transposed ? compat[pos][k] : compat[k][pos];
+        if (value >= 0.0 || (nbest == SPARSE_MATCHES && value >= bestValue[nbest - 1]))
+            continue;
+        if (nbest < SPARSE_MATCHES)
+            nbest++;
+        for (b = nbest - 1; b > 0 && bestValue[b - 1] > value; b--) {
+            best[b] = best[b - 1];
+            bestValue[b] = bestValue[b - 1];
+        }
+        best[b] = k;
+        bestValue[b] = value;
+    }
+
+    bool found;
+    for (b = 0; b < nbest; b++) {
+        found = false;
+        for (int a = 0; a < row.size && !found; a++)
+            found = (row.pos[a] == best[b]);
+        if (!found)
+            appendCandidate(row, best[b], 0.0);
+    }
+}
+
+void GradientDescent::addNeighborMatches(int i, int pos) {
+    int c = i % ncols;
+    int r = i / ncols;
+    if (c > 0 && !clampedTile.test(i - 1))
+        addMatches(rows[i - 1], pos, hCompat, false);
+    if (c + 1 < ncols && !clampedTile.test(i + 1))
+        addMatches(rows[i + 1], pos, hCompat, true);
+    if (r > 0 && !clampedTile.test(i - ncols))
+        addMatches(rows[i - ncols], pos, vCompat, false);
+    if (r + 1 < nrows && !clampedTile.test(i + ncols))
+        addMatches(rows[i + ncols], pos, vCompat, true);
+}
+
+void GradientDescent::addSparseContribution(candidates &row, candidates &other,
+                                            float **compat, bool transposed) {
+    double sum;
+    int k;
+    for (int a = 0; a < row.size; a++) {
+        k = row.pos[a];
+        sum = 0.0;
+        if (transposed) {
+            // dF_j[k] = inner product of k-th column of compat and p_i
+            for (int b = 0; b < other.size; b++)
+                sum += compat[other.pos[b]][k] * other.p[b];
+        } else {
+            // dF_i[k] = inner product of k-th row of compat and p_j
+            for (int b = 0; b < other.size; b++)
+                sum += compat[k][other.pos[b]] * other.p[b];
+        }
+        row.dF[a] += sum;
+    }
+}
+
+void GradientDescent::computeSparseDescentVector() {
+    PSQP_TRACE_SCOPE("GradientDescent::computeSparseDescentVector");
+    /**
+     * Same as computeDescentVector, restricted to live candidates.
+     * Clamped tiles keep a single candidate (their position, with value 1),
+     * so they still contribute to their neighbors.
+     * */
+
+    // clear accumulator
+    for (int i = 0; i < ntiles; i++) {
+        if (!clampedTile.test(i))
+            for (int a = 0; a < rows[i].size; a++)
+                rows[i].dF[a] = 0.0;
+    }
+
+    int i, j;
+    // add horizontal cost contributions
+    for (int r = 0; r < nrows; r++) {
+        for (int c = 0; c + 1 < ncols; c++) {
+            i = c + r * ncols;
+            j = i + 1;
+            if (!clampedTile.test(i))
+                addSparseContribution(rows[i], rows[j], hCompat, false);
+            if (!clampedTile.test(j))
+                addSparseContribution(rows[j], rows[i], hCompat, true);
+        }
+    }
+
+    // add vertical cost contributions
+    for (int c = 0; c < ncols; c++) {
+        for (int r = 0; r + 1 < nrows; r++) {
+            i = c + r * ncols;
+            j = i + ncols;
+            if (!clampedTile.test(i))
+                addSparseContribution(rows[i], rows[j], vCompat, false);
+            if (!clampedTile.test(j))
+                addSparseContribution(rows[j], rows[i], vCompat, true);
+        }
+    }
+}
+
+void GradientDescent::constrainSparseDescentVector() {
+    PSQP_TRACE_SCOPE("GradientDescent::constrainSparseDescentVector");
+    float lambda;
+    bool isZero = true;
+
+    // apply row constraints, averaging over each position's live candidates
+    for (int j = 0; j < ntiles; j++) {
+        colSum[j] = 0.0;
+        colCount[j] = 0;
+    }
+    for (int i = 0; i < ntiles; i++) {
+        if (clampedTile.test(i))
+            continue;
+        for (int a = 0; a < rows[i].size; a++) {
+            colSum[rows[i].pos[a]] += rows[i].dF[a];
+            colCount[rows[i].pos[a]]++;
+        }
+    }
+    for (int i = 0; i < ntiles; i++) {
+        if (clampedTile.test(i))
+            continue;
+        for (int a = 0; a < rows[i].size; a++)
+            rows[i].dF[a] -= colSum[rows[i].pos[a]] / (float) colCount[rows[i].pos[a]];
+    }
+
+    // apply column constraints, averaging over each tile's live candidates
+    for (int i = 0; i < ntiles; i++) {
+        if (clampedTile.test(i) || rows[i].size == 0)
+            continue;
+        lambda = 0.0f;
+        for (int a = 0; a < rows[i].size; a++)
+            lambda += rows[i].dF[a];
+        lambda /= (float) rows[i].size;
+        for (int a = 0; a < rows[i].size; a++) {
+            rows[i].dF[a] -= lambda;
+            if (rows[i].dF[a] > MIN_THRESHOLD)
+                isZero = false;
+        }
+    }
+
+    if (isZero)
+        stopCriteria = true;
+}
+
+void GradientDescent::restartSparsePermutation() {
+    float p0;
+    int blend;
+    for (int i = 0; i < ntiles; i++) {
+        if (clampedTile.test(i) || rows[i].size == 0)
+            continue;
+        p0 = 1.0 / (float) rows[i].size;
+
+        // blend the prior in if it is still a candidate
+        blend = -1;
+        for (int a = 0; a < rows[i].size && prior != NULL; a++)
+            if (rows[i].pos[a] == prior[i])
+                blend = a;
+        if (blend != -1)
+            p0 *= (1.0 - priorWeight);
+
+        for (int a = 0; a < rows[i].size; a++)
+            rows[i].p[a] = p0;
+        if (blend != -1)
+            rows[i].p[blend] += priorWeight;
+    }
+}
+
+void GradientDescent::compactCandidates() {
+    int size;
+    for (int i = 0; i < ntiles; i++) {
+        if (clampedTile.test(i))
+            continue;
+        candidates &row = rows[i];
+        size = 0;
+        for (int a = 0; a < row.size; a++) {
+            if (clampedPosition.test(row.pos[a]) || row.p[a] < MIN_THRESHOLD)
+                continue;
+            row.pos[size] = row.pos[a];
+            row.p[size] = row.p[a];
+            row.dF[size] = row.dF[a];
+            size++;
+        }
+        row.size = size;
+
+        // Give memory back once most candidates are gone
+        if (size > 0 && size <= row.capacity / 2) {
+            row.pos = (int*) realloc(row.pos, size * sizeof(int));
+            row.p = (float*) realloc(row.p, size * sizeof(float));
+            row.dF = (float*) realloc(row.dF, size * sizeof(float));
+            row.capacity = size;
+        }
+    }
+}
+
+void GradientDescent::updateSparsePermutation() {
+    PSQP_TRACE_SCOPE("GradientDescent::updateSparsePermutation");
+    // p = p - step*dF;
+
+    if (stopCriteria)
+        return;
+
+    step = computeSparseStep();
+
+    for (int i = 0; i < ntiles; i++) {
+        if (!clampedTile.test(i))
+            for (int a = 0; a < rows[i].size; a++)
+                rows[i].p[a] -= step * rows[i].dF[a];
+    }
+
+    QVector<int> clamped;
+    int j;
+    for (int i = 0; i < ntiles; i++) {
+        if (clampedTile.test(i))
+            continue;
+        for (int a = 0; a < rows[i].size; a++) {
+            j = rows[i].pos[a];
+            if (clampedPosition.test(j) || rows[i].p[a] <= MAX_THRESHOLD)
+                continue;
+            clamped << i;
+            clampedTile.set(i);
+            clampedPosition.set(j);
+            clampCount++;
+            solution[i] = j;
+            qDebug() << "CLAMP: " << i << " " << j;
+
+            // A clamped tile keeps its position as its only candidate
+            rows[i].pos[0] = j;
+            rows[i].p[0] = 1.0;
+            rows[i].dF[0] = 0.0;
+            rows[i].size = 1;
+            break;
+        }
+    }
+
+    // Zeroed entries and clamped positions leave the candidate lists
+    compactCandidates();
+
+    if (!clamped.isEmpty()) {
+        // Clamped positions bring their best matches to their neighbors
+        for (int k = 0; k < clamped.size(); k++)
+            addNeighborMatches(clamped[k], solution[clamped[k]]);
+        restartSparsePermutation();
+        qDebug() << clampCount << " / " << ntiles;
+    }
+
+    // If all tiles are clamped, stop criteria is reached
+    if (clampCount == ntiles)
+        stopCriteria = true;
+}
+
+double GradientDescent::computeSparseStep() {
+    // Same line search as computeStep, over live candidates only.
+
+    mpf_t a, b, x, aux, aux2;
+    bool doBreak = false;
+    int pos = 0;
+
+    mpf_init(a);
+    mpf_init_set_d(b, 0.5);
+    mpf_init(x);
+    mpf_init(aux2);
+    mpf_init(aux);
+
+    do {
+        doBreak = false;
+        mpf_add(x, a, b);
+        mpf_div_ui(x, x, 2);
+        for (int i = 0; i < ntiles && !doBreak; i++) {
+            if (clampedTile.test(i))
+                continue;
+            for (int k = 0; k < rows[i].size; k++) {
+                mpf_set_d(aux, rows[i].dF[k]);
+                mpf_mul(aux2, aux, x);
+                mpf_set_d(aux, rows[i].p[k]);
+                mpf_sub(aux2, aux, aux2);
+                if (mpf_sgn(aux2) < 0 || mpf_cmp_d(aux2, 1.0) > 0) {
+                    doBreak = true;
+                    break;
+                }
+            }
+        }
+        if (doBreak) {
+            mpf_set(b, x);
+            pos = 0;
+        } else {
+            mpf_set(a, x);
+            pos = 1;
+        }
+        mpf_sub(aux2, b, a);
+    } while ((mpf_cmp_d(aux2, MIN_THRESHOLD) > 0) || !pos);
+
+    double finalStep = mpf_get_d(x);
+    mpf_clear(aux2);
+    mpf_clear(a);
+    mpf_clear(b);
+    mpf_clear(x);
+    mpf_clear(aux);
+
+    return finalStep;
+}
@@ -0,0 +1,270 @@
+#include <queue>
+#include <vector>
+
+#include "optimization/greedyPlacer.h"
+#include "trace.h"
+
+GreedyPlacer::GreedyPlacer(Compatibility *compat, int ncols, int nrows) {
+    this->ncols = ncols;
+    this->nrows = nrows;
+    ntiles = ncols * nrows;
+    neighbors = (compat != NULL) ? compat->getNeighbors() : NULL;
+
+    canvasCols = 2 * ncols - 1;
+    canvasRows = 2 * nrows - 1;
+}
+
+GreedyPlacer::~GreedyPlacer() {
+}
+
+/**
+ * Order placements so that the most compatible one is on top of the queue.
+ * */
+struct placementComparison {
+    bool operator()(const GreedyPlacer::placement &a, const GreedyPlacer::placement &b) const {
+        if (a.score != b.score)
+            return a.score > b.score;
+        return a.distance > b.distance;
+    }
+};
+
+int *GreedyPlacer::solve(float **hCompat, float **vCompat, float **pInit) {
+    PSQP_TRACE_SCOPE("GreedyPlacer::solve");
+    this->hCompat = hCompat;
+    this->vCompat = vCompat;
+    ownNeighbors = (neighbors == NULL);
+    if (ownNeighbors)
+        rankNeighbors();
+
+    canvas = new int[canvasCols * canvasRows];
+    for (int i = 0; i < canvasCols * canvasRows; i++)
+        canvas[i] = -1;
+    placed = (bool*) calloc(ntiles, sizeof(bool));
+    cursor = new int*[ntiles];
+    for (int i = 0; i < ntiles; i++) {
+        cursor[i] = new int[4];
+        for (int b = 0; b < 4; b++)
+            cursor[i][b] = 0;
+    }
+
+    // Start from the center of the canvas, so the puzzle can grow in any direction
+    int seed = findSeed();
+    int slot = (ncols - 1) + (nrows - 1) * canvasCols;
+    canvas[slot] = seed;
+    placed[seed] = true;
+    minCol = maxCol = ncols - 1;
+    minRow = maxRow = nrows - 1;
+
+    std::priority_queue<placement, std::vector<placement>, placementComparison> queue;
+    placement current, best;
+    int count = 1, c, r, nslot;
+    const int dc[4] = {1, -1, 0, 0};
+    const int dr[4] = {0, 0, 1, -1};
+    while (count < ntiles) {
+        // Open the slots around the last placed tile
+        c = slot % canvasCols;
+        r = slot / canvasCols;
+        for (int d = 0; d < 4; d++) {
+            if (c + dc[d] < 0 || c + dc[d] >= canvasCols || r + dr[d] < 0 || r + dr[d] >= canvasRows)
+                continue;
+            nslot = (c + dc[d]) + (r + dr[d]) * canvasCols;
+            if (isOpen(nslot) && bestPlacement(nslot, best))
+                queue.push(best);
+        }
+
+        // Take the most compatible placement still valid
+        slot = -1;
+        while (!queue.empty()) {
+            current = queue.top();
+            queue.pop();
+            if (!isOpen(current.slot) || !bestPlacement(current.slot, best))
+                continue;
+            if (best.tile != current.tile || best.score != current.score
+                    || best.distance != current.distance) {
+                queue.push(best);
+                continue;
+            }
+            slot = current.slot;
+            break;
+        }
+        if (slot == -1)
+            break;
+
+        canvas[slot] = current.tile;
+        placed[current.tile] = true;
+        minCol = qMin(minCol, slot % canvasCols);
+        maxCol = qMax(maxCol, slot % canvasCols);
+        minRow = qMin(minRow, slot / canvasCols);
+        maxRow = qMax(maxRow, slot / canvasCols);
+        count++;
+    }
+
+    // Crop the canvas to the puzzle
+    int *solution = new int[ntiles];
+    int next = 0;
+    for (int i = 0; i < nrows; i++) {
+        for (int j = 0; j < ncols; j++) {
+            c = minCol + j;
+            r = minRow + i;
+            if (c < canvasCols && r < canvasRows && canvas[c + r * canvasCols] != -1) {
+                solution[j + i * ncols] = canvas[c + r * canvasCols];
+            } else {
+                while (placed[next])
+                    next++;
+                solution[j + i * ncols] = next;
+                placed[next] = true;
+            }
+        }
+    }
+
+    for (int i = 0; i < ntiles; i++)
+        delete[] cursor[i];
+    delete[] cursor;
+    delete[] canvas;
+    free(placed);
+
+    if (ownNeighbors) {
+        for (int i = 0; i < ntiles; i++) {
+            for (int b = 0; b < 4; b++)
+                free(neighbors[i][b]);
+            free(neighbors[i]);
+        }
+        free(neighbors);
+        neighbors = NULL;
+    }
+
+    // Every tile is placed in a single pass
+    converged = true;
+    return solution;
+}
+
+void GreedyPlacer::rankNeighbors() {
+    int pos;
+    neighbors = (Compatibility::neighbor***) calloc(ntiles, sizeof(Compatibility::neighbor**));
+    for (int i = 0; i < ntiles; i++) {
+        neighbors[i] = (Compatibility::neighbor**) calloc(4, sizeof(Compatibility::neighbor*));
+        for (int b = 0; b < 4; b++) {
+            neighbors[i][b] = (Compatibility::neighbor*) calloc(qMax(1, ntiles - 1),
+                                                                sizeof(Compatibility::neighbor));
+            pos = 0;
+            for (int k = 0; k < ntiles; k++) {
+                if (k == i)
+                    continue;
+                neighbors[i][b][pos].num = k;
+                if (b == Tile::R)
+                    neighbors[i][b][pos].distance = hCompat[i][k];
+                else if (b == Tile::L)
+                    neighbors[i][b][pos].distance = hCompat[k][i];
+                else if (b == Tile::B)
+                    neighbors[i][b][pos].distance = vCompat[i][k];
+                else
+                    neighbors[i][b][pos].distance = vCompat[k][i];
+                pos++;
+            }
+            qsort(neighbors[i][b], (ntiles - 1), sizeof(Compatibility::neighbor),
+                  neighborsComparisonByDistance);
+        }
+    }
+}
+
+int GreedyPlacer::findSeed() {
+    int seed = 0, maxBuddies = -1, buddies, best, other;
+    if (ntiles < 2)
+        return seed;
+    for (int i = 0; i < ntiles; i++) {
+        buddies = 0;
+        for (int b = 0; b < 4; b++) {
+            other = (b == Tile::R || b == Tile::B) ? b + 1 : b - 1;
+            best = neighbors[i][b][0].num;
+            if (neighbors[best][other][0].num == i)
+                buddies++;
+        }
+        if (buddies > maxBuddies) {
+            maxBuddies = buddies;
+            seed = i;
+        }
+    }
+    return seed;
+}
+
+bool GreedyPlacer::isOpen(int slot) {
+    if (canvas[slot] != -1)
+        return false;
+    int c = slot % canvasCols;
+    int r = slot / canvasCols;
+    return (qMax(maxCol, c) - qMin(minCol, c) < ncols)
+            && (qMax(maxRow, r) - qMin(minRow, r) < nrows);
+}
+
+float GreedyPlacer::score(int slot, int tile) {
+    int c = slot % canvasCols;
+    int r = slot / canvasCols;
+    float total = 0.0;
+    if (c > 0 && canvas[slot - 1] != -1)
+        total += hCompat[canvas[slot - 1]][tile];
+    if (c + 1 < canvasCols && canvas[slot + 1] != -1)
+        total += hCompat[tile][canvas[slot + 1]];
+    if (r > 0 && canvas[slot - canvasCols] != -1)
+        total += vCompat[canvas[slot - canvasCols]][tile];
+    if (r + 1 < canvasRows && canvas[slot + canvasCols] != -1)
+        total += vCompat[tile][canvas[slot + canvasCols]];
+    return total;
+}
+
+bool GreedyPlacer::bestPlacement(int slot, placement &best) {
+    int c = slot % canvasCols;
+    int r = slot / canvasCols;
+
+    /**
+     * For each placed tile around the slot: its position relative to the
+     * slot, and its border facing the slot.
+     * */
+    int around[4], borders[4], n = 0;
+    if (c > 0 && canvas[slot - 1] != -1) {
+        around[n] = canvas[slot - 1];
+        borders[n++] = Tile::R;
+    }
+    if (c + 1 < canvasCols && canvas[slot + 1] != -1) {
+        around[n] = canvas[slot + 1];
+        borders[n++] = Tile::L;
+    }
+    if (r > 0 && canvas[slot - canvasCols] != -1) {
+        around[n] = canvas[slot - canvasCols];
+        borders[n++] = Tile::B;
+    }
+    if (r + 1 < canvasRows && canvas[slot + canvasCols] != -1) {
+        around[n] = canvas[slot + canvasCols];
+        borders[n++] = Tile::T;
+    }
+
+    bool found = false;
+    int tile, rank, taken;
+    float value;
+    for (int k = 0; k < n; k++) {
+        Compatibility::neighbor *list = neighbors[around[k]][borders[k]];
+
+        // Placed tiles never become free again, so skip them for good
+        int &first = cursor[around[k]][borders[k]];
+        while (first < ntiles - 1 && placed[list[first].num])
+            first++;
+
+        taken = 0;
+        for (rank = first; rank < ntiles - 1 && taken < GREEDY_CANDIDATES; rank++) {
+            tile = list[rank].num;
+            if (placed[tile])
+                continue;
+            taken++;
+            value = score(slot, tile);
+            if (!found || value < best.score
+                    || (value == best.score && list[rank].distance < best.distance)) {
+                best.score = value;
+                best.distance = list[rank].distance;
+                best.slot = slot;
+                best.tile = tile;
+                found = true;
+            }
+        }
+    }
+
+    return found;
+}
@@ -0,0 +1,410 @@
+#include <QtConcurrentMap>
+
+#include "optimization/localSearch.h"
+#include "trace.h"
+
+/**
+ * Struct to pass one tile's distance computation to a thread.
+ */
+struct distanceTask {
+    LocalSearch *search;
+    int tile;
+    bool done;
+};
+
+/**
+ * Cache one tile's distances (runs concurrently).
+ * */
+void computeTileDistances(distanceTask &task) {
+    task.done = task.search->computeDistances(task.tile);
+}
+
+/**
+ * Search one task's moves (runs concurrently).
+ * */
+void searchLocalMoves(LocalSearch::searchTask &task) {
+    task.search->searchMoves(task);
+}
+
+/**
+ * Compare moves by cost change, largest decrease first.
+ * */
+int movesComparisonByDelta(const void *a, const void *b) {
+    const LocalSearch::move *ma = (const LocalSearch::move *) a;
+    const LocalSearch::move *mb = (const LocalSearch::move *) b;
+    if (ma->delta < mb->delta)
+        return -1;
+    if (ma->delta > mb->delta)
+        return 1;
+    return ma->a - mb->a;
+}
+
+LocalSearch::LocalSearch(TiledImage *tiledImage, const QElapsedTimer *timer, int timeBudget) {
+    this->tiledImage = tiledImage;
+    this->timer = timer;
+    this->timeBudget = timeBudget;
+    this->ncols = tiledImage->getNCols();
+    this->nrows = tiledImage->getNRows();
+    ntiles = ncols * nrows;
+
+    // Same normalization as Solver::computeCost
+    Tile *tile = tiledImage->getTile(0);
+    hWeight = (ncols > 1) ? (float) tile->getHeight() / (nrows * (ncols - 1)) : 0.0;
+    vWeight = (nrows > 1) ? (float) tile->getWidth() / (ncols * (nrows - 1)) : 0.0;
+
+    hDist = new float*[ntiles];
+    vDist = new float*[ntiles];
+    QVector<distanceTask> tasks(ntiles);
+    for (int i = 0; i < ntiles; i++) {
+        hDist[i] = NULL;
+        vDist[i] = NULL;
+        tasks[i].search = this;
+        tasks[i].tile = i;
+    }
+    QtConcurrent::blockingMap(tasks, computeTileDistances);
+    cached = true;
+    for (int i = 0; i < ntiles; i++)
+        cached = cached && tasks[i].done;
+}
+
+LocalSearch::~LocalSearch() {
+    for (int i = 0; i < ntiles; i++) {
+        delete[] hDist[i];
+        delete[] vDist[i];
+    }
+    delete[] hDist;
+    delete[] vDist;
+}
+
+bool LocalSearch::isCached() {
+    return cached;
+}
+
+bool LocalSearch::computeDistances(int tile) {
+    PSQP_TRACE_SCOPE("LocalSearch::computeDistances");
+    // Once the budget is gone, the remaining tiles are neither allocated nor computed
+    if (timer != NULL && timeBudget > 0 && timer->elapsed() >= timeBudget)
+        return false;
+    hDist[tile] = new float[ntiles];
+    vDist[tile] = new float[ntiles];
+    TileDescriptor **desc = tiledImage->getTile(tile)->getDescriptors();
+    TileDescriptor **other;
+    for (int j = 0; j < ntiles; j++) {
+        other = tiledImage->getTile(j)->getDescriptors();
+        hDist[tile][j] = hWeight * desc[Tile::R]->computeDistance(other[Tile::L], false);
+        vDist[tile][j] = vWeight * desc[Tile::B]->computeDistance(other[Tile::T], false);
+    }
+    return true;
+}
+
+double LocalSearch::computeCost(int *perm) {
+    double cost = 0.0;
+    int pos;
+    for (int r = 0; r < nrows; r++) {
+        for (int c = 0; c < ncols; c++) {
+            pos = c + r * ncols;
+            if (c + 1 < ncols)
+                cost += hDist[perm[pos]][perm[pos + 1]];
+            if (r + 1 < nrows)
+                cost += vDist[perm[pos]][perm[pos + ncols]];
+        }
+    }
+    return cost;
+}
+
+int LocalSearch::expandMove(const move &m, int *perm, int *positions, int *newTiles) {
+    int n = 0, pa, pb, step;
+    switch (m.type) {
+    case SWAP:
+        positions[0] = m.a;
+        newTiles[0] = perm[m.b];
+        positions[1] = m.b;
+        newTiles[1] = perm[m.a];
+        n = 2;
+        break;
+    case BLOCK:
+        for (int dy = 0; dy < m.size; dy++) {
+            for (int dx = 0; dx < m.size; dx++) {
+                pa = m.a + dx + dy * ncols;
+                pb = m.b + dx + dy * ncols;
+                positions[n] = pa;
+                newTiles[n++] = perm[pb];
+                positions[n] = pb;
+                newTiles[n++] = perm[pa];
+            }
+        }
+        break;
+    case ROW:
+    case COLUMN:
+        // Rotate the segment by one: every tile moves one position along it,
+        // and the last one wraps around to the other end
+        step = (m.type == ROW) ? 1 : ncols;
+        for (int k = 0; k < m.size; k++) {
+            positions[n] = m.a + k * step;
+            if (m.b > 0)
+                newTiles[n++] = perm[m.a + ((k + m.size - 1) % m.size) * step];
+            else
+                newTiles[n++] = perm[m.a + ((k + 1) % m.size) * step];
+        }
+        break;
+    }
+    return n;
+}
+
+double LocalSearch::computeDelta(searchTask &task, move &m) {
+    int *perm = task.perm;
+    int *stamp = task.stamp;
+    int *tileAt = task.tileAt;
+    int n = expandMove(m, perm, task.positions, task.newTiles);
+
+    // Mark the changed positions, so their shared edges are counted once
+    task.mark++;
+    for (int k = 0; k < n; k++) {
+        stamp[task.positions[k]] = task.mark;
+        tileAt[task.positions[k]] = task.newTiles[k];
+    }
+
+    double before = 0.0, after = 0.0;
+    int q, c, r, o, tq, to;
+    for (int k = 0; k < n; k++) {
+        q = task.positions[k];
+        c = q % ncols;
+        r = q / ncols;
+        tq = tileAt[q];
+        if (c + 1 < ncols) {
+            o = q + 1;
+            to = (stamp[o] == task.mark) ? tileAt[o] : perm[o];
+            before += hDist[perm[q]][perm[o]];
+            after += hDist[tq][to];
+        }
+        if (c > 0 && stamp[q - 1] != task.mark) {
+            o = q - 1;
+            before += hDist[perm[o]][perm[q]];
+            after += hDist[perm[o]][tq];
+        }
+        if (r + 1 < nrows) {
+            o = q + ncols;
+            to = (stamp[o] == task.mark) ? tileAt[o] : perm[o];
+            before += vDist[perm[q]][perm[o]];
+            after += vDist[tq][to];
+        }
+        if (r > 0 && stamp[q - ncols] != task.mark) {
+            o = q - ncols;
+            before += vDist[perm[o]][perm[q]];
+            after += vDist[perm[o]][tq];
+        }
+    }
+    return after - before;
+}
+
+void LocalSearch::tryMove(searchTask &task, move m, move &best) {
+    m.delta = computeDelta(task, m);
+    if (m.delta < best.delta)
+        best = m;
+}
+
+void LocalSearch::collectDirty() {
+    dirtyPositions.clear();
+    for (int q = 0; q < ntiles; q++)
+        if (dirty[q])
+            dirtyPositions << q;
+
+    int c, r, corner;
+    for (int size = 2; size <= LS_MAX_BLOCK; size++) {
+        dirtyCorners[size].clear();
+        for (int q = 0; q < ntiles; q++)
+            dirtyBlock[size][q] = false;
+        for (int k = 0; k < dirtyPositions.size(); k++) {
+            c = dirtyPositions[k] % ncols;
+            r = dirtyPositions[k] / ncols;
+            for (int dy = 0; dy < size && dy <= r; dy++) {
+                for (int dx = 0; dx < size && dx <= c; dx++) {
+                    corner = (c - dx) + (r - dy) * ncols;
+                    if ((c - dx) + size > ncols || (r - dy) + size > nrows)
+                        continue;
+                    dirtyBlock[size][corner] = true;
+                }
+            }
+        }
+        for (int q = 0; q < ntiles; q++)
+            if (dirtyBlock[size][q])
+                dirtyCorners[size] << q;
+    }
+}
+
+void LocalSearch::searchMoves(searchTask &task) {
+    PSQP_TRACE_SCOPE("LocalSearch::searchMoves");
+    move m, best;
+    int c, r, cb, rb, k;
+    bool segmentDirty;
+    for (int a = task.first; a < ntiles; a += task.stride) {
+        c = a % ncols;
+        r = a / ncols;
+        best.delta = -LS_EPSILON;
+        best.type = -1;
+        m.a = a;
+
+        // Tile swaps: with every tile if a is dirty, else with dirty tiles only
+        m.type = SWAP;
+        m.size = 1;
+        if (dirty[a]) {
+            for (m.b = a + 1; m.b < ntiles; m.b++)
+                tryMove(task, m, best);
+        } else {
+            for (k = 0; k < dirtyPositions.size(); k++) {
+                m.b = dirtyPositions[k];
+                if (m.b > a)
+                    tryMove(task, m, best);
+            }
+        }
+
+        // Block swaps, with a as the top left corner of the first block
+        m.type = BLOCK;
+        for (m.size = 2; m.size <= LS_MAX_BLOCK; m.size++) {
+            if (c + m.size > ncols || r + m.size > nrows)
+                break;
+            const QVector<int> &corners = dirtyCorners[m.size];
+            int nb = dirtyBlock[m.size][a] ? ntiles : corners.size();
+            for (k = 0; k < nb; k++) {
+                m.b = dirtyBlock[m.size][a] ? k : corners[k];
+                if (m.b <= a)
+                    continue;
+                cb = m.b % ncols;
+                rb = m.b / ncols;
+                if (cb + m.size > ncols || rb + m.size > nrows)
+                    continue;
+                if (qAbs(cb - c) < m.size && qAbs(rb - r) < m.size)
+                    continue;
+                tryMove(task, m, best);
+            }
+        }
+
+        // Row and column segments starting at a (length 2 is a swap)
+        m.type = ROW;
+        segmentDirty = dirty[a] || (c + 1 < ncols && dirty[a + 1]);
+        for (m.size = 3; c + m.size <= ncols; m.size++) {
+            segmentDirty = segmentDirty || dirty[a + m.size - 1];
+            if (!segmentDirty)
+                continue;
+            for (m.b = -1; m.b <= 1; m.b += 2)
+                tryMove(task, m, best);
+        }
+        m.type = COLUMN;
+        segmentDirty = dirty[a] || (r + 1 < nrows && dirty[a + ncols]);
+        for (m.size = 3; r + m.size <= nrows; m.size++) {
+            segmentDirty = segmentDirty || dirty[a + (m.size - 1) * ncols];
+            if (!segmentDirty)
+                continue;
+            for (m.b = -1; m.b <= 1; m.b += 2)
+                tryMove(task, m, best);
+        }
+
+        if (best.type != -1)
+            task.moves.append(best);
+    }
+}
+
+int LocalSearch::refine(int *perm, int timeBudget) {
+    PSQP_TRACE_SCOPE("LocalSearch::refine");
+    QElapsedTimer timer;
+    timer.start();
+
+    int nthreads = qMax(1, QThread::idealThreadCount());
+    int bufferSize = qMax(2 * LS_MAX_BLOCK * LS_MAX_BLOCK, qMax(ncols, nrows));
+    QVector<searchTask> tasks(nthreads);
+    for (int k = 0; k < nthreads; k++) {
+        tasks[k].search = this;
+        tasks[k].perm = perm;
+        tasks[k].first = k;
+        tasks[k].stride = nthreads;
+        tasks[k].stamp = (int*) calloc(ntiles, sizeof(int));
+        tasks[k].tileAt = new int[ntiles];
+        tasks[k].positions = new int[bufferSize];
+        tasks[k].newTiles = new int[bufferSize];
+        tasks[k].mark = 0;
+    }
+    int *positions = new int[bufferSize];
+    int *newTiles = new int[bufferSize];
+    bool *touched = new bool[ntiles];
+    dirty = new bool[ntiles];
+    for (int size = 2; size <= LS_MAX_BLOCK; size++)
+        dirtyBlock[size] = new bool[ntiles];
+    for (int i = 0; i < ntiles; i++)
+        dirty[i] = true;
+
+    qDebug() << "Local search starting cost: " << computeCost(perm);
+
+    int applied = 0, rounds = 0, n, q;
+    bool isFree;
+    QVector<move> moves;
+    while (timeBudget == 0 || timer.elapsed() < timeBudget) {
+        moves.clear();
+        for (int k = 0; k < nthreads; k++)
+            tasks[k].moves.clear();
+        collectDirty();
+        QtConcurrent::blockingMap(tasks, searchLocalMoves);
+        for (int k = 0; k < nthreads; k++)
+            moves += tasks[k].moves;
+        if (moves.isEmpty())
+            break;
+        qsort(moves.data(), moves.size(), sizeof(move), movesComparisonByDelta);
+
+        /**
+         * Apply the best moves first. A move is applied only if none of its
+         * positions is or neighbors a position changed in this round, so its
+         * edges are untouched and its cost change still holds.
+         * */
+        for (int i = 0; i < ntiles; i++) {
+            touched[i] = false;
+            dirty[i] = false;
+        }
+        for (int i = 0; i < moves.size(); i++) {
+            n = expandMove(moves[i], perm, positions, newTiles);
+            isFree = true;
+            for (int k = 0; k < n && isFree; k++)
+                isFree = !touched[positions[k]];
+            if (!isFree) {
+                // Search its anchor again in the next round
+                dirty[moves[i].a] = true;
+                continue;
+            }
+            for (int k = 0; k < n; k++) {
+                q = positions[k];
+                perm[q] = newTiles[k];
+                touched[q] = true;
+                if (q % ncols > 0)
+                    touched[q - 1] = true;
+                if (q % ncols + 1 < ncols)
+                    touched[q + 1] = true;
+                if (q >= ncols)
+                    touched[q - ncols] = true;
+                if (q + ncols < ntiles)
+                    touched[q + ncols] = true;
+            }
+            applied++;
+        }
+        // Moves over touched positions have new cost changes
+        for (int i = 0; i < ntiles; i++)
+            dirty[i] = dirty[i] || touched[i];
+        rounds++;
+    }
+
+    qDebug() << "Local search: " << applied << " moves in " << rounds << " rounds, "
+             << timer.elapsed() << " ms";
+    qDebug() << "Local search final cost: " << computeCost(perm);
+
+    for (int k = 0; k < nthreads; k++) {
+        free(tasks[k].stamp);
+        delete[] tasks[k].tileAt;
+        delete[] tasks[k].positions;
+        delete[] tasks[k].newTiles;
+    }
+    delete[] positions;
+    delete[] newTiles;
+    delete[] touched;
+    delete[] dirty;
+    for (int size = 2; size <= LS_MAX_BLOCK; size++)
+        delete[] dirtyBlock[size];
+
+    return applied;
+}
@@ -1,44 +1,422 @@
+#include <QtConcurrentMap>
+#include <limits.h>
+#include <float.h>
+
 #include "tile/compatibility.h"
 #include "optimization/solver.h"
 #include "optimization/gradientDescent.h"
+#include "optimization/frankWolfe.h"
+#include "optimization/greedyPlacer.h"
+#include "optimization/localSearch.h"
+#include "trace.h"
 
 Solver::Solver(TiledImage *tiledImage) {
     this->tiledImage = tiledImage;
     ncols = tiledImage->getNCols();
     nrows = tiledImage->getNRows();
     ntiles = ncols * nrows;
+
+    windowSize = 0;
+    windowOverlap = 0;
+    sparse = false;
+    backend = "GradientDescent";
+    greedyWeight = 0.0;
+    monitor = NULL;
+    timeBudget = 0;
+    iterationBudget = 0;
+    cost = 0.0;
+    converged = false;
+    iterations = 0;
+    compatibilityTime = 0;
+    optimizationTime = 0;
+}
+
+void Solver::setWindows(int windowSize, int overlap) {
+    if (windowSize != 0 && windowSize < 2)
+        qFatal("Windows must have at least 2 columns and rows.\n");
+    if (overlap < 0 || (windowSize > 0 && overlap >= windowSize))
+        qFatal("Window overlap must be smaller than the window size.\n");
+
+    this->windowSize = windowSize;
+    this->windowOverlap = overlap;
+}
+
+void Solver::setSparse(bool sparse) {
+    this->sparse = sparse;
+}
+
+void Solver::setBackend(QString backend) {
+    this->backend = backend;
+}
+
+void Solver::setGreedyInit(float weight) {
+    if (weight < 0.0 || weight > 1.0)
+        qFatal("Greedy placement weight must be between 0 and 1.\n");
+    this->greedyWeight = weight;
+}
+
+void Solver::setMonitor(SolverMonitor *monitor) {
+    this->monitor = monitor;
+}
+
+void Solver::setBudget(int timeBudget, int iterationBudget) {
+    if (timeBudget < 0 || iterationBudget < 0)
+        qFatal("Solver budget must not be negative.\n");
+    this->timeBudget = timeBudget;
+    this->iterationBudget = iterationBudget;
+}
+
+float Solver::getCost() {
+    return cost;
+}
+
+bool Solver::hasConverged() {
+    return converged;
+}
+
+int Solver::getIterations() {
+    return iterations;
+}
+
+qint64 Solver::getCompatibilityTime() {
+    return compatibilityTime;
+}
+
+qint64 Solver::getOptimizationTime() {
+    return optimizationTime;
+}
+
+Optimizer *Solver::createOptimizer(QString backend, Compatibility *compat, int ncols, int nrows,
+                                   bool sparse, int *prior, float priorWeight) {
+    if (backend == "FrankWolfe")
+        return new FrankWolfe(ncols, nrows);
+    if (backend == "Greedy")
+        return new GreedyPlacer(compat, ncols, nrows);
+
+    GradientDescent *gd = new GradientDescent(NULL, ncols, nrows);
+    gd->setSparse(sparse);
+    gd->setPrior(prior, priorWeight);
+    return gd;
 }
 
 int *Solver::solve() {
+    PSQP_TRACE_SCOPE("Solver::solve");
     int *perm;
-    
+    budgetTimer.start();
+
     qDebug() << "Computing compatibility...";
-    Compatibility *compat = new Compatibility(tiledImage->getTiles(), ncols, nrows);
+    QElapsedTimer timer;
+    timer.start();
+    Compatibility *compat = new Compatibility(tiledImage);
+    compatibilityTime = timer.restart();
     qDebug() << "Done!";
 
     float **hCompat = compat->getCompatibilityMatrix()[0];
     float **vCompat = compat->getCompatibilityMatrix()[1];
 
-    // Initializing solver
+    /**
+     * Greedy placement to start near a good solution. Windows always need
+     * it: each window only rearranges the tiles it starts with, so they
+     * must come from a placement close to the solution, not from the
+     * current (shuffled) one. Sparse gradient descent takes its initial
+     * candidates from it.
+     * */
+    bool windowed = windowSize > 0 && (windowSize < ncols || windowSize < nrows);
+    bool sparseDescent = sparse && backend == "GradientDescent";
+    int *seed = NULL;
+    if (greedyWeight > 0.0 || windowed || sparseDescent) {
+        qDebug() << "Placing tiles greedily...";
+        GreedyPlacer placer(compat, ncols, nrows);
+        seed = placer.solve(hCompat, vCompat, NULL);
+        qDebug() << "Done! Greedy cost: " << computeCost(seed);
+    }
+
+    if (windowed) {
+        qDebug() << "Solving puzzle by windows...";
+        perm = solveWindows(hCompat, vCompat, seed);
+        optimizationTime = timer.elapsed();
+        qDebug() << "Done!";
+        delete[] seed;
+        delete compat;
+
+        cost = computeCost(perm);
+        qDebug() << "Solution cost: " << cost;
+        qDebug() << "Converged: " << converged;
+        return perm;
+    }
+
+    // The greedy backend would place the tiles again: its solution is the seed
+    if (backend == "Greedy" && seed != NULL) {
+        perm = seed;
+        converged = true;
+        iterations = 0;
+        optimizationTime = timer.elapsed();
+        delete compat;
+
+        cost = computeCost(perm);
+        qDebug() << "Solver: " << backend << "(greedy placement reused)";
+        qDebug() << "Solution cost: " << cost;
+        return perm;
+    }
+
+    // Initializing solver (sparse mode and the greedy placer need no initial matrix)
     float p0 = 1.0f / ((float) ntiles);
-    float **pInit = new float*[ntiles];
-    for (int i = 0; i < ntiles; i++) {
-        pInit[i] = new float[ntiles];
-        for (int j = 0; j < ntiles; j++)
-            pInit[i][j] = p0;
+    float **pInit = NULL;
+    if (backend == "FrankWolfe" || (backend != "Greedy" && !sparse)) {
+        pInit = new float*[ntiles];
+        for (int i = 0; i < ntiles; i++) {
+            pInit[i] = new float[ntiles];
+            for (int j = 0; j < ntiles; j++)
+                pInit[i][j] = (seed != NULL) ? (1.0f - greedyWeight) * p0 : p0;
+            if (seed != NULL)
+                pInit[i][seed[i]] += greedyWeight;
+        }
     }
 
-    // Run Gradient Descent and get optimum permutation
+    // The backend gets what is left of the time budget
+    qint64 remaining = 0;
+    if (timeBudget > 0)
+        remaining = qMax((qint64) 1, timeBudget - budgetTimer.elapsed());
+
+    // Run optimization backend and get optimum permutation
+    qDebug() << "Solver: " << backend;
     qDebug() << "Solving puzzle...";
-    GradientDescent gd(tiledImage->getTiles(), ncols, nrows);
-    perm = gd.solve(hCompat, vCompat, pInit);
-    qDebug() << "Done!";
+    Optimizer *optimizer = createOptimizer(backend, compat, ncols, nrows, sparse,
+                                           seed, greedyWeight);
+    optimizer->setMonitor(monitor);
+    optimizer->setBudget(remaining, iterationBudget);
+    perm = optimizer->solve(hCompat, vCompat, pInit);
+    converged = optimizer->hasConverged();
+    iterations = optimizer->getIterations();
+    delete optimizer;
+    delete[] seed;
+    optimizationTime = timer.elapsed();
+    qDebug() << "Done! Solver time (ms): " << optimizationTime;
 
-    for (int i = 0; i < ntiles; i++)
-        delete[] pInit[i];
+    if (pInit != NULL) {
+        for (int i = 0; i < ntiles; i++)
+            delete[] pInit[i];
+        delete[] pInit;
+    }
+    delete compat;
+
+    cost = computeCost(perm);
+    qDebug() << "Solution cost: " << cost;
+    qDebug() << "Converged: " << converged;
+
+    return perm;
+}
+
+/**
+ * Solve one window of the puzzle with its optimization backend, over the
+ * tiles the greedy placement puts in it. With a prior weight, the window
+ * starts near that placement.
+ * */
+void solveWindow(Solver::window &w) {
+    PSQP_TRACE_SCOPE("Solver::solveWindow");
+    int n = w.ncols * w.nrows;
+    float p0 = 1.0f / ((float) n);
+    int *prior = new int[n];
+    for (int i = 0; i < n; i++)
+        prior[i] = i;
+
+    float **hSub = new float*[n];
+    float **vSub = new float*[n];
+    bool dense = w.backend == "FrankWolfe" || (w.backend != "Greedy" && !w.sparse);
+    float **pInit = dense ? new float*[n] : NULL;
+    for (int i = 0; i < n; i++) {
+        hSub[i] = new float[n];
+        vSub[i] = new float[n];
+        for (int j = 0; j < n; j++) {
+            hSub[i][j] = w.hCompat[w.tiles[i]][w.tiles[j]];
+            vSub[i][j] = w.vCompat[w.tiles[i]][w.tiles[j]];
+        }
+        if (pInit != NULL) {
+            pInit[i] = new float[n];
+            for (int j = 0; j < n; j++)
+                pInit[i][j] = (1.0f - w.priorWeight) * p0;
+            pInit[i][i] += w.priorWeight;
+        }
+    }
+
+    Optimizer *optimizer = Solver::createOptimizer(w.backend, NULL, w.ncols, w.nrows, w.sparse,
+                                                   prior, w.priorWeight);
+    optimizer->setMonitor(w.monitor);
+    // Windows may wait for a thread: each gets what is left of the time budget
+    qint64 remaining = 0;
+    if (w.deadline > 0)
+        remaining = qMax((qint64) 1, w.deadline - w.budgetTimer->elapsed());
+    optimizer->setBudget(remaining, w.iterationBudget);
+    int *subPerm = optimizer->solve(hSub, vSub, pInit);
+    w.converged = optimizer->hasConverged();
+    w.iterations = optimizer->getIterations();
+    delete optimizer;
+    delete[] prior;
+    for (int i = 0; i < n; i++)
+        w.solution[i] = w.tiles[subPerm[i]];
+
+    for (int i = 0; i < n; i++) {
+        delete[] hSub[i];
+        delete[] vSub[i];
+        if (pInit != NULL)
+            delete[] pInit[i];
+    }
+    delete[] hSub;
+    delete[] vSub;
     delete[] pInit;
+    delete[] subPerm;
+}
+
+/**
+ * Placement of a tile proposed by a window. Depth is the distance
+ * from the placement to the window's closest inner edge.
+ * */
+struct windowVote {
+    int pos, tile, depth;
+};
+
+/**
+ * Compare window placements by depth, deepest first.
+ * */
+int votesComparisonByDepth(const void *a, const void *b) {
+    const windowVote *va = (const windowVote *) a;
+    const windowVote *vb = (const windowVote *) b;
+    if (va->depth != vb->depth)
+        return vb->depth - va->depth;
+    return va->pos - vb->pos;
+}
+
+QVector<int> Solver::windowOrigins(int length, int size) {
+    QVector<int> origins;
+    int stride = qMax(1, size - windowOverlap);
+    for (int origin = 0; origin + size < length; origin += stride)
+        origins << origin;
+    origins << length - size;
+    return origins;
+}
+
+int *Solver::solveWindows(float **hCompat, float **vCompat, int *arrangement) {
+    int wcols = qMin(windowSize, ncols);
+    int wrows = qMin(windowSize, nrows);
+    QVector<int> colOrigins = windowOrigins(ncols, wcols);
+    QVector<int> rowOrigins = windowOrigins(nrows, wrows);
+
+    // Each window takes the tiles the arrangement places in its positions
+    QVector<window> windows;
+    for (int r = 0; r < rowOrigins.size(); r++) {
+        for (int c = 0; c < colOrigins.size(); c++) {
+            window w;
+            w.col = colOrigins[c];
+            w.row = rowOrigins[r];
+            w.ncols = wcols;
+            w.nrows = wrows;
+            w.tiles = new int[wcols * wrows];
+            w.solution = new int[wcols * wrows];
+            w.hCompat = hCompat;
+            w.vCompat = vCompat;
+            w.sparse = sparse;
+            w.backend = backend;
+            w.priorWeight = greedyWeight;
+            w.monitor = monitor;
+            w.budgetTimer = &budgetTimer;
+            w.deadline = timeBudget;
+            w.iterationBudget = iterationBudget;
+            w.converged = false;
+            w.iterations = 0;
+            for (int i = 0; i < wrows; i++)
+                for (int j = 0; j < wcols; j++)
+                    w.tiles[j + i * wcols] = arrangement[(w.col + j) + (w.row + i) * ncols];
+            windows << w;
+        }
+    }
+    qDebug() << "# of windows: " << windows.size();
 
-    qDebug() << "Solution cost: " << computeCost(perm);
+    QtConcurrent::blockingMap(windows, solveWindow);
+    converged = true;
+    iterations = 0;
+    for (int k = 0; k < windows.size(); k++) {
+        converged = converged && windows[k].converged;
+        iterations += windows[k].iterations;
+    }
+
+    /**
+     * Reconcile overlapping windows: a placement far from its window's
+     * inner edges is more reliable, so deeper placements are kept first.
+     * Edges on the puzzle's border do not limit depth.
+     * */
+    QVector<windowVote> votes;
+    for (int k = 0; k < windows.size(); k++) {
+        window &w = windows[k];
+        for (int i = 0; i < w.nrows; i++) {
+            for (int j = 0; j < w.ncols; j++) {
+                windowVote v;
+                v.pos = (w.col + j) + (w.row + i) * ncols;
+                v.tile = w.solution[j + i * w.ncols];
+                v.depth = INT_MAX;
+                if (w.col > 0)
+                    v.depth = qMin(v.depth, j);
+                if (w.col + w.ncols < ncols)
+                    v.depth = qMin(v.depth, w.ncols - 1 - j);
+                if (w.row > 0)
+                    v.depth = qMin(v.depth, i);
+                if (w.row + w.nrows < nrows)
+                    v.depth = qMin(v.depth, w.nrows - 1 - i);
+                votes << v;
+            }
+        }
+    }
+    qsort(votes.data(), votes.size(), sizeof(windowVote), votesComparisonByDepth);
+
+    int *perm = new int[ntiles];
+    bool *placed = (bool*) calloc(ntiles, sizeof(bool));
+    for (int i = 0; i < ntiles; i++)
+        perm[i] = -1;
+    for (int i = 0; i < votes.size(); i++) {
+        if (perm[votes[i].pos] == -1 && !placed[votes[i].tile]) {
+            perm[votes[i].pos] = votes[i].tile;
+            placed[votes[i].tile] = true;
+        }
+    }
+
+    /**
+     * Fill positions left by conflicting placements, in order, with the
+     * remaining tile most compatible with the tiles already around them.
+     * */
+    int col, row, best;
+    float score, bestScore;
+    for (int i = 0; i < ntiles; i++) {
+        if (perm[i] != -1)
+            continue;
+        col = i % ncols;
+        row = i / ncols;
+        best = -1;
+        bestScore = FLT_MAX;
+        for (int t = 0; t < ntiles; t++) {
+            if (placed[t])
+                continue;
+            score = 0.0;
+            if (col > 0 && perm[i - 1] != -1)
+                score += hCompat[perm[i - 1]][t];
+            if (col + 1 < ncols && perm[i + 1] != -1)
+                score += hCompat[t][perm[i + 1]];
+            if (row > 0 && perm[i - ncols] != -1)
+                score += vCompat[perm[i - ncols]][t];
+            if (row + 1 < nrows && perm[i + ncols] != -1)
+                score += vCompat[t][perm[i + ncols]];
+            if (score < bestScore) {
+                bestScore = score;
+                best = t;
+            }
+        }
+        perm[i] = best;
+        placed[best] = true;
+    }
+
+    free(placed);
+    for (int k = 0; k < windows.size(); k++) {
+        delete[] windows[k].tiles;
+        delete[] windows[k].solution;
+    }
 
     return perm;
 }
@@ -51,7 +429,6 @@ float Solver::computeCost(int *perm) {
 
     int pos = 0;
     int tile1, tile2;
-    Tile *tiles = tiledImage->getTiles();
     // Horizontal cost
     for (int j = 0; j < nrows; j++) {
         for (int i = 0; i < ncols - 1; i++) {
@@ -59,8 +436,8 @@ float Solver::computeCost(int *perm) {
             tile1 = perm[pos];
             tile2 = perm[pos + 1];
             cost =
-                    (tiles[tile1].getDescriptors()[Tile::R])->computeDistance(
-                        (tiles[tile2].getDescriptors()[Tile::L]), false);
+                    (tiledImage->getTile(tile1)->getDescriptors()[Tile::R])->computeDistance(
+                        (tiledImage->getTile(tile2)->getDescriptors()[Tile::L]), false);
             totalHCost += cost;
         }
     }
@@ -71,56 +448,97 @@ float Solver::computeCost(int *perm) {
             tile1 = perm[pos];
             tile2 = perm[pos + ncols];
             cost =
-                    (tiles[tile1].getDescriptors()[Tile::B])->computeDistance(
-                        (tiles[tile2].getDescriptors()[Tile::T]), false);
+                    (tiledImage->getTile(tile1)->getDescriptors()[Tile::B])->computeDistance(
+                        (tiledImage->getTile(tile2)->getDescriptors()[Tile::T]), false);
             totalVCost += cost;
         }
     }
 
     // Sum and normalize costs
+    Tile *tile = tiledImage->getTile(0);
     if (ncols > 1 && nrows > 1)
-        totalCost = totalHCost * tiles[0].getHeight() / (nrows * (ncols - 1))
-                  + totalVCost * tiles[0].getWidth() / (ncols * (nrows - 1));
+        totalCost = totalHCost * tile->getHeight() / (nrows * (ncols - 1))
+                  + totalVCost * tile->getWidth() / (ncols * (nrows - 1));
     else if (ncols > 1)
-        totalCost = totalHCost * tiles[0].getHeight() / (nrows * (ncols - 1));
+        totalCost = totalHCost * tile->getHeight() / (nrows * (ncols - 1));
     else
-        totalCost = totalVCost * tiles[0].getWidth() / (ncols * (nrows - 1));
+        totalCost = totalVCost * tile->getWidth() / (ncols * (nrows - 1));
 
     return totalCost;
 }
 
+/**
+ * Struct to pass one tile's wrap-around edges to a thread.
+ */
+struct wrapEdge {
+    Tile *tile, *right, *below;
+    float hCost, vCost;
+};
+
+/**
+ * Compute the cost of a tile's edges to its right and bottom neighbors,
+ * wrapping around the puzzle (runs concurrently).
+ * */
+void computeWrapEdge(wrapEdge &edge) {
+    edge.hCost = (edge.tile->getDescriptors()[Tile::R])->computeDistance(
+                (edge.right->getDescriptors()[Tile::L]), false);
+    edge.vCost = (edge.tile->getDescriptors()[Tile::B])->computeDistance(
+                (edge.below->getDescriptors()[Tile::T]), false);
+}
+
 int *Solver::optimizeShift() {
-    int col, row, pos, sHmin = 0, sVmin = 0;
-    double cost, costMin;
+    PSQP_TRACE_SCOPE("Solver::optimizeShift");
+    /**
+     * A cyclic shift keeps every edge of the wrapped-around puzzle but one
+     * column boundary and one row boundary, which become the puzzle's
+     * borders. So the cost of a shift is the total cost of the wrapped edges
+     * minus the cost of the cut boundaries, and the best shift cuts the
+     * most expensive column boundary and the most expensive row boundary.
+     * */
+    QVector<wrapEdge> edges(ntiles);
+    for (int i = 0; i < ntiles; i++) {
+        edges[i].tile = tiledImage->getTile(i);
+        edges[i].right = tiledImage->getTile((i % ncols + 1) % ncols + (i / ncols) * ncols);
+        edges[i].below = tiledImage->getTile((i + ncols) % ntiles);
+    }
+    QtConcurrent::blockingMap(edges, computeWrapEdge);
 
-    int *auxPermutation = new int[ntiles];
-    for (int i = 0; i < ntiles; i++)
-        auxPermutation[i] = i;
-    costMin = computeCost(auxPermutation);
-
-    // Look for best shift (min cost solution) horizontally and vertically, based on solution cost
-    for (int shiftH = 0; shiftH < (ncols - 1); shiftH++) {
-        for (int shiftV = 0; shiftV < (nrows - 1); shiftV++) {
-            for (int i = 0; i < ntiles; i++) {
-                row = (i / ncols) + shiftV;
-                col = (i % ncols) + shiftH;
-                if (row > (nrows - 1))
-                    row -= nrows;
-                if (col > (ncols - 1))
-                    col -= ncols;
-                pos = col + row * ncols;
-                auxPermutation[pos] = i;
-            }
-            cost = computeCost(auxPermutation);
-            if (cost < costMin) {
-                costMin = cost;
+    // Cost of the boundary after each column and after each row
+    double *colCost = (double*) calloc(ncols, sizeof(double));
+    double *rowCost = (double*) calloc(nrows, sizeof(double));
+    double totalH = 0.0, totalV = 0.0;
+    for (int i = 0; i < ntiles; i++) {
+        colCost[i % ncols] += edges[i].hCost;
+        rowCost[i / ncols] += edges[i].vCost;
+        totalH += edges[i].hCost;
+        totalV += edges[i].vCost;
+    }
+
+    // Same normalization as computeCost
+    Tile *tile = tiledImage->getTile(0);
+    double hWeight = (ncols > 1) ? (double) tile->getHeight() / (nrows * (ncols - 1)) : 0.0;
+    double vWeight = (nrows > 1) ? (double) tile->getWidth() / (ncols * (nrows - 1)) : 0.0;
+
+    // Score every shift; shifting by s cuts the boundary after column (row) n - 1 - s
+    int sHmin = 0, sVmin = 0;
+    double shiftCost, costMin = DBL_MAX;
+    for (int shiftH = 0; shiftH < ncols; shiftH++) {
+        for (int shiftV = 0; shiftV < nrows; shiftV++) {
+            shiftCost = hWeight * (totalH - colCost[ncols - 1 - shiftH])
+                      + vWeight * (totalV - rowCost[nrows - 1 - shiftV]);
+            if (shiftCost < costMin) {
+                costMin = shiftCost;
                 sHmin = shiftH;
                 sVmin = shiftV;
             }
         }
     }
+    free(colCost);
+    free(rowCost);
 
     // Compute permutation based on best shift
+    int col, row, pos;
+    int *auxPermutation = new int[ntiles];
     for (int i = 0; i < ntiles; i++) {
         row = (i / ncols) + sVmin;
         col = (i % ncols) + sHmin;
@@ -132,7 +550,32 @@ int *Solver::optimizeShift() {
         auxPermutation[pos] = i;
     }
 
-    qDebug() << "Solution cost: " << computeCost(auxPermutation);
+    qDebug() << "Shift: " << sHmin << " x " << sVmin;
+    cost = computeCost(auxPermutation);
+    qDebug() << "Solution cost: " << cost;
 
     return auxPermutation;
 }
+
+int *Solver::refine(int timeBudget) {
+    PSQP_TRACE_SCOPE("Solver::refine");
+    int *perm = new int[ntiles];
+    for (int i = 0; i < ntiles; i++)
+        perm[i] = i;
+
+    // The budget covers caching the distances too
+    QElapsedTimer timer;
+    timer.start();
+    qDebug() << "Caching border distances...";
+    LocalSearch search(tiledImage, &timer, timeBudget);
+    int remaining = timeBudget - timer.elapsed();
+    if (!search.isCached() || (timeBudget > 0 && remaining <= 0))
+        qDebug() << "Time budget expired while caching border distances.";
+    else
+        search.refine(perm, (timeBudget > 0) ? remaining : 0);
+
+    cost = computeCost(perm);
+    qDebug() << "Solution cost: " << cost;
+
+    return perm;
+}
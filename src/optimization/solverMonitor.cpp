@@ -0,0 +1,21 @@
+#include "optimization/solverMonitor.h"
+
+SolverMonitor::SolverMonitor(QObject *parent) :
+        QObject(parent), canceled(0) {
+}
+
+void SolverMonitor::cancel() {
+    canceled.fetchAndStoreOrdered(1);
+}
+
+void SolverMonitor::reset() {
+    canceled.fetchAndStoreOrdered(0);
+}
+
+bool SolverMonitor::isCanceled() {
+    return canceled == 1;
+}
+
+void SolverMonitor::reportProgress(int done, int total, int iteration, double cost) {
+    emit progress(done, total, iteration, cost);
+}
@@ -1,12 +1,85 @@
 #include "psqp.h"
 #include "optimization/gradientDescent.h"
 
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+/**
+ * Escape a string for a JSON report.
+ * */
+static QString jsonString(QString text) {
+    QString escaped;
+    for (int i = 0; i < text.size(); i++) {
+        QChar c = text[i];
+        if (c == '\\' || c == '"')
+            escaped += QString("\\") + c;
+        else if (c == '\n')
+            escaped += "\\n";
+        else if (c == '\r')
+            escaped += "\\r";
+        else if (c == '\t')
+            escaped += "\\t";
+        else if (c.unicode() < 0x20)
+            escaped += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0'));
+        else
+            escaped += c;
+    }
+    return "\"" + escaped + "\"";
+}
+
+/**
+ * Format a number for a JSON report: null if it is not finite.
+ * */
+static QString jsonNumber(double value) {
+    if (!qIsFinite(value))
+        return "null";
+    return QString::number(value);
+}
+
+/**
+ * Format an accuracy for a JSON report: null if it was not computed.
+ * */
+static QString jsonAccuracy(double accuracy) {
+    return (accuracy < 0.0) ? QString("null") : jsonNumber(accuracy);
+}
+
+/**
+ * Peak resident memory of the process, in kilobytes (-1 if unknown).
+ * */
+static long peakMemory() {
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+#ifdef Q_OS_MAC
+    // Bytes on Mac OS, kilobytes elsewhere
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return -1;
+#endif
+}
+
 PSQP::PSQP() {
     image = NULL;
+    streaming = false;
+    preCut = false;
     tiledImage = NULL;
     solver = NULL;
+    windowSize = 0;
+    windowOverlap = 0;
+    sparse = false;
+    greedyWeight = 0.0;
+    timeBudget = 0;
+    iterationBudget = 0;
+    monitor = new SolverMonitor(this);
 
-    descriptorOptions << "Pomeranz" << "Gallagher";
+    descriptorOptions = DescriptorRegistry::getNames();
+    solverOptions << "GradientDescent" << "FrankWolfe" << "Greedy";
+    backend = solverOptions[0];
 }
 
 PSQP::~PSQP() {
@@ -23,7 +96,33 @@ PSQP::~PSQP() {
 void PSQP::setImage(QString imageFile) {
     qDebug() << imageFile;
     this->imageFile = imageFile;
-    image = new QImage(imageFile);
+    delete image;
+    image = NULL;
+    // A new puzzle starts a new run
+    stageNames.clear();
+    stageTimes.clear();
+    // Pre-cut tiles and streamed images are only decoded by their tiled image
+    preCut = TiledImage::isPreCut(imageFile);
+    if (preCut && streaming)
+        qFatal("Cannot stream %s: pre-cut tiles are not streamed.\n", qPrintable(imageFile));
+    QImageReader reader(imageFile);
+    if (!preCut && !reader.canRead())
+        qFatal("Could not decode image %s: %s\n", qPrintable(imageFile),
+               qPrintable(reader.errorString()));
+    bool stream = streaming && TiledImage::canStream(imageFile);
+    if (streaming && !stream)
+        qDebug() << "Cannot stream" << imageFile
+                 << "(its format cannot decode a region): decoding it whole.";
+    if (!preCut && !stream) {
+        QElapsedTimer timer;
+        timer.start();
+        image = new QImage(imageFile);
+        recordStage("decode", timer.elapsed());
+    }
+}
+
+void PSQP::setStreaming(bool streaming) {
+    this->streaming = streaming;
 }
 
 void PSQP::setPuzzleSize(int ncols, int nrows) {
@@ -31,20 +130,121 @@ void PSQP::setPuzzleSize(int ncols, int nrows) {
     this->nrows = nrows;
     ntiles = this->ncols * this->nrows;
 
-    if (image == NULL)
+    if (imageFile.isEmpty())
         qFatal("Call PSQP::setImage before PSQP::setPuzzleSize.\n");
 
+    QElapsedTimer timer;
+    timer.start();
     delete tiledImage;
-    tiledImage = new TiledImage(image, ncols, nrows);
+    if (preCut)
+        tiledImage = new TiledImage(TiledImage::listTileFiles(imageFile), ncols, nrows);
+    else if (image == NULL)
+        tiledImage = new TiledImage(imageFile, ncols, nrows);
+    else
+        tiledImage = new TiledImage(image, ncols, nrows);
+    recordStage("tiling", timer.elapsed());
 }
 
 void PSQP::setDescriptor(QString desc, float paramP, float paramQ) {
     if (tiledImage == NULL)
         qFatal("Call PSQP::setPuzzleSize before PSQP::setDescriptor.\n");
     
+    QElapsedTimer timer;
+    timer.start();
     tiledImage->setDescriptor(desc, paramP, paramQ);
+    recordStage("descriptors", timer.elapsed());
+    descriptor = desc;
+    createSolver();
+}
+
+void PSQP::loadPuzzle(QString puzzleFile) {
+    qDebug() << puzzleFile;
+    imageFile = puzzleFile;
+    delete image;
+    image = NULL;
+    stageNames.clear();
+    stageTimes.clear();
+    preCut = false;
+
+    QElapsedTimer timer;
+    timer.start();
+    delete tiledImage;
+    PuzzleFile *puzzle = new PuzzleFile(puzzleFile);
+    descriptor = puzzle->getDescriptor();
+    tiledImage = new TiledImage(puzzle);
+    recordStage("load", timer.elapsed());
+    ncols = tiledImage->getNCols();
+    nrows = tiledImage->getNRows();
+    ntiles = ncols * nrows;
+    createSolver();
+}
+
+void PSQP::savePuzzle(QString puzzleFile, int thumbnailSize) {
+    if (solver == NULL)
+        qFatal("Call PSQP::setDescriptor before PSQP::savePuzzle.\n");
+    PuzzleFile::save(puzzleFile, tiledImage, thumbnailSize);
+}
+
+void PSQP::createSolver() {
     delete solver;
     solver = new Solver(tiledImage);
+    solver->setWindows(windowSize, windowOverlap);
+    solver->setSparse(sparse);
+    solver->setBackend(backend);
+    solver->setGreedyInit(greedyWeight);
+    solver->setMonitor(monitor);
+    solver->setBudget(timeBudget, iterationBudget);
+}
+
+void PSQP::setWindows(int windowSize, int overlap) {
+    this->windowSize = windowSize;
+    this->windowOverlap = overlap;
+    if (solver != NULL)
+        solver->setWindows(windowSize, overlap);
+}
+
+void PSQP::setSolver(QString backend) {
+    if (!solverOptions.contains(backend))
+        qFatal("Unknown solver %s.\n", qPrintable(backend));
+
+    this->backend = backend;
+    if (solver != NULL)
+        solver->setBackend(backend);
+}
+
+void PSQP::setSparse(bool sparse) {
+    this->sparse = sparse;
+    if (solver != NULL)
+        solver->setSparse(sparse);
+}
+
+void PSQP::setGreedyInit(float weight) {
+    this->greedyWeight = weight;
+    if (solver != NULL)
+        solver->setGreedyInit(weight);
+}
+
+void PSQP::setBudget(int timeBudget, int iterationBudget) {
+    this->timeBudget = timeBudget;
+    this->iterationBudget = iterationBudget;
+    if (solver != NULL)
+        solver->setBudget(timeBudget, iterationBudget);
+}
+
+float PSQP::getCost() {
+    if (solver == NULL)
+        qFatal("Call PSQP::setDescriptor before PSQP::getCost.\n");
+    return solver->getCost();
+}
+
+bool PSQP::hasConverged() {
+    if (solver == NULL)
+        qFatal("Call PSQP::setDescriptor before PSQP::hasConverged.\n");
+    return solver->hasConverged();
+}
+
+SolverMonitor *PSQP::getMonitor() {
+    return monitor;
 }
 
 TiledImage* PSQP::getTiledImage() {
@@ -55,12 +255,33 @@ QStringList PSQP::getDescriptorNames() {
        return descriptorOptions;
 }
 
+QStringList PSQP::getSolverNames() {
+    return solverOptions;
+}
+
 void PSQP::optimizeShift() {
     if (solver == NULL)
         qFatal("Call PSQP::setDescriptor before PSQP::optimizeShift.\n");
 
+    QElapsedTimer timer;
+    timer.start();
     int *perm = solver->optimizeShift();
+    recordStage("shift", timer.elapsed());
     tiledImage->permutTiles(perm);
+    delete[] perm;
+    tiledImage->computeMetrics();
+}
+
+void PSQP::refine(int timeBudget) {
+    if (solver == NULL)
+        qFatal("Call PSQP::setDescriptor before PSQP::refine.\n");
+
+    QElapsedTimer timer;
+    timer.start();
+    int *perm = solver->refine(timeBudget);
+    recordStage("refine", timer.elapsed());
+    tiledImage->permutTiles(perm);
+    delete[] perm;
     tiledImage->computeMetrics();
 }
 
@@ -69,8 +290,62 @@ void PSQP::runSolver() {
         qFatal("Call PSQP::setDescriptor before PSQP::runSolver.\n");
 
     int *perm = solver->solve();
+    recordStage("compatibility", solver->getCompatibilityTime());
+    recordStage("optimization", solver->getOptimizationTime());
+    // A canceled solve leaves the puzzle as it was
+    if (monitor->isCanceled()) {
+        qDebug() << "Solver canceled.";
+        delete[] perm;
+        return;
+    }
     tiledImage->permutTiles(perm);
+    delete[] perm;
     tiledImage->computeMetrics();
 
     qDebug() << "-------------------------------------------------------";
 }
+
+void PSQP::recordStage(QString stage, qint64 time) {
+    int index = stageNames.indexOf(stage);
+    if (index == -1) {
+        stageNames << stage;
+        stageTimes << time;
+    } else {
+        stageTimes[index] = time;
+    }
+}
+
+void PSQP::writeReport(QString reportFile) {
+    if (solver == NULL)
+        qFatal("Call PSQP::setDescriptor before PSQP::writeReport.\n");
+
+    QFile file(reportFile);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        qFatal("Could not write report %s.\n", qPrintable(reportFile));
+
+    qint64 total = 0;
+    QTextStream out(&file);
+    out << "{\n";
+    out << "  \"input\": " << jsonString(imageFile) << ",\n";
+    out << "  \"columns\": " << ncols << ",\n";
+    out << "  \"rows\": " << nrows << ",\n";
+    out << "  \"descriptor\": " << jsonString(descriptor) << ",\n";
+    out << "  \"solver\": " << jsonString(backend) << ",\n";
+    out << "  \"direct_accuracy\": " << jsonAccuracy(tiledImage->getDirectAccuracy()) << ",\n";
+    out << "  \"neighbor_accuracy\": " << jsonAccuracy(tiledImage->getNeighborAccuracy()) << ",\n";
+    out << "  \"cost\": " << jsonNumber(solver->getCost()) << ",\n";
+    out << "  \"converged\": " << (solver->hasConverged() ? "true" : "false") << ",\n";
+    out << "  \"iterations\": " << solver->getIterations() << ",\n";
+    out << "  \"stage_ms\": {";
+    for (int i = 0; i < stageNames.size(); i++) {
+        out << (i > 0 ? ", " : "") << jsonString(stageNames[i]) << ": " << stageTimes[i];
+        total += stageTimes[i];
+    }
+    out << "},\n";
+    out << "  \"total_ms\": " << total << ",\n";
+    out << "  \"peak_memory_kb\": " << (qint64) peakMemory() << ",\n";
+    out << "  \"threads\": " << QThreadPool::globalInstance()->maxThreadCount() << "\n";
+    out << "}\n";
+
+    qDebug() << "Report: " << reportFile;
+}
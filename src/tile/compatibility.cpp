@@ -2,12 +2,14 @@
 
 #include "tile/tile.h"
 #include "tile/compatibility.h"
+#include "trace.h"
 
-Compatibility::Compatibility(Tile *tiles, int ncols, int nrows) {
-    this->ncols = ncols;
-    this->nrows = nrows;
+Compatibility::Compatibility(TiledImage *tiledImage) {
+    PSQP_TRACE_SCOPE("Compatibility::Compatibility");
+    this->ncols = tiledImage->getNCols();
+    this->nrows = tiledImage->getNRows();
     this->ntiles = ncols * nrows;
-    this->tiles = tiles;
+    this->tiledImage = tiledImage;
 
     // Horizontal and Vertical compatibilities
     compatibilityMatrix = new float**[2];
@@ -78,27 +80,37 @@ int neighborsComparisonByDistance(const void *a, const void *b) {
 }
 
 void Compatibility::computeNeighbors() {
-    int pos = 0;
-    float dist;
+    PSQP_TRACE_SCOPE("Compatibility::computeNeighbors");
+    // All tiles share the descriptor type: one batch kernel call per border
+    const DescriptorRegistry::entry *type = tiledImage->getTile(0)->getDescriptorType();
+    TileDescriptor **others = new TileDescriptor*[ntiles - 1];
+    float *distances = new float[ntiles - 1];
+
+    int pos = 0, oBorder;
     for (int i = 0; i < ntiles; i++) { // For each tile
         for (int j = 0; j < 4; j++) { // For each border
+            oBorder = otherBorder(j);
             pos = 0;
             for (int k = 0; k < ntiles; k++) { // Compute distance to every other tile
                 if (k == i)
                     continue;
                 neighbors[i][j][pos].num = k;
-                dist = tiles[i].computeDistance(&tiles[k], j);
-                neighbors[i][j][pos].distance = dist;
-                pos++;
+                others[pos++] = tiledImage->getTile(k)->getDescriptors()[oBorder];
             }
+            type->distances(tiledImage->getTile(i)->getDescriptors()[j], others, ntiles - 1, true, distances);
+            for (pos = 0; pos < ntiles - 1; pos++)
+                neighbors[i][j][pos].distance = distances[pos];
             // Sort the distances
             qsort(neighbors[i][j], (ntiles - 1), sizeof(struct neighbor),
                   neighborsComparisonByDistance);
         }
     }
+    delete[] others;
+    delete[] distances;
 }
 
 void Compatibility::findConstantBorders() {
+    PSQP_TRACE_SCOPE("Compatibility::findConstantBorders");
     constantBorders = (bool**) calloc(ntiles, sizeof(bool*));
     for (int i = 0; i < ntiles; i++)
         constantBorders[i] = (bool*) calloc(4, sizeof(bool));
@@ -141,6 +153,7 @@ void Compatibility::findConstantBorders() {
 
 
 void Compatibility::computeCompatibilityMatrix() {
+    PSQP_TRACE_SCOPE("Compatibility::computeCompatibilityMatrix");
     float sigma, value, aux;
     int jNeighbor, oBorder;
 
@@ -219,3 +232,7 @@ int Compatibility::otherBorder(int border) {
 float*** Compatibility::getCompatibilityMatrix() {
     return compatibilityMatrix;
 }
+
+Compatibility::neighbor*** Compatibility::getNeighbors() {
+    return neighbors;
+}
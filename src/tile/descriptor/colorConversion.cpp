@@ -0,0 +1,39 @@
+#include "tile/descriptor/colorConversion.h"
+
+/**
+ * Contributions to the LAB channels: contribution[c][k][v] is the
+ * contribution to LAB channel c of RGB channel k at 8-bit value v,
+ * computed as in the per-pixel conversion, so the sums match it exactly.
+ * */
+struct labTables {
+    double contribution[3][3][256];
+
+    labTables() {
+        static const double weights[3][3] = {
+            {0.299, 0.587, 0.114},
+            {0.596, -0.274, -0.322},
+            {0.211, -0.523, 0.312}
+        };
+        float value;
+        for (int v = 0; v < 256; v++) {
+            value = v / 255.0;
+            for (int c = 0; c < 3; c++)
+                for (int k = 0; k < 3; k++)
+                    contribution[c][k][v] = weights[c][k] * value;
+        }
+    }
+};
+
+void ColorConversion::RGBtoLAB(const float *rgb, float *lab, int n) {
+    static const labTables tables;
+    const double (*t)[3][256] = tables.contribution;
+    int r, g, b;
+    for (int i = 0; i < 3 * n; i += 3) {
+        r = (int) rgb[i];
+        g = (int) rgb[i + 1];
+        b = (int) rgb[i + 2];
+        lab[i] = t[0][0][r] + t[0][1][g] + t[0][2][b];
+        lab[i + 1] = 7.0 * (t[1][0][r] + t[1][1][g] + t[1][2][b]);
+        lab[i + 2] = 7.0 * (t[2][0][r] + t[2][1][g] + t[2][2][b]);
+    }
+}
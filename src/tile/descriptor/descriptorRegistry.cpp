@@ -0,0 +1,58 @@
+#include "tile/tile.h"
+#include "tile/descriptor/descriptorRegistry.h"
+#include "tile/descriptor/pomeranzDescriptor.h"
+#include "tile/descriptor/gallagherDescriptor.h"
+
+/**
+ * Create a descriptor of type D.
+ * */
+template<class D>
+static TileDescriptor *createDescriptor(float paramP, float paramQ) {
+    return new D(paramP, paramQ);
+}
+
+/**
+ * Registered descriptors, the default one first. Adding a descriptor
+ * only takes its entry here.
+ * */
+static const DescriptorRegistry::entry entries[] = {
+    {"Pomeranz", PomeranzDescriptor::LINES, &createDescriptor<PomeranzDescriptor>,
+     &PomeranzDescriptor::extractFeatures, &DescriptorRegistry::computeDistances},
+    {"Gallagher", GallagherDescriptor::LINES, &createDescriptor<GallagherDescriptor>,
+     &GallagherDescriptor::extractFeatures, &DescriptorRegistry::computeDistances}
+};
+
+static const int nentries = sizeof(entries) / sizeof(entries[0]);
+
+const DescriptorRegistry::entry *DescriptorRegistry::find(QString name) {
+    for (int i = 0; i < nentries; i++) {
+        if (name == entries[i].name)
+            return &entries[i];
+    }
+    return NULL;
+}
+
+QStringList DescriptorRegistry::getNames() {
+    QStringList names;
+    for (int i = 0; i < nentries; i++)
+        names << entries[i].name;
+    return names;
+}
+
+void DescriptorRegistry::extractBorders(TileDescriptor **descriptors, const QImage &image) {
+    for (int i = 0; i < 4; i++)
+        descriptors[i]->createFeatureVector(image, i);
+}
+
+void DescriptorRegistry::computeDistances(TileDescriptor *descriptor, TileDescriptor **others,
+                                          int n, bool param, float *distances) {
+    TileDescriptor::DistanceKernel kernel = descriptor->getDistanceKernel(param);
+    int border = descriptor->getBorder();
+    if ((border == Tile::R) || (border == Tile::B)) {
+        for (int k = 0; k < n; k++)
+            distances[k] = kernel(descriptor, others[k]);
+    } else {
+        for (int k = 0; k < n; k++)
+            distances[k] = kernel(others[k], descriptor);
+    }
+}
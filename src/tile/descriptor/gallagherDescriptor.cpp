@@ -1,6 +1,8 @@
 #include "tile/tile.h"
 #include "tile/descriptor/gallagherDescriptor.h"
 #include "tile/descriptor/colorConversion.h"
+#include "tile/descriptor/distanceKernel.h"
+#include "trace.h"
 
 GallagherDescriptor::GallagherDescriptor(float paramP, float paramQ) 
                   : TileDescriptor(paramP, paramQ) {
@@ -20,104 +22,82 @@ GallagherDescriptor::GallagherDescriptor(float paramP, float paramQ)
      * else if (border == T)
      * 	tileDescriptor = {0  1  2  3 ;  4  5  6  7}
      */
+    kernel = selectDistanceKernel<GallagherDescriptor>(paramP, paramQ);
 }
 
 GallagherDescriptor::~GallagherDescriptor() {
-    for (int i = 0; i < size; i++)
-        free(tileDescriptor[i]);
-    free(tileDescriptor);
 }
 
+/**
+ * To avoid numerical problems related to the inversion of the covariance,
+ * and the inherent issues of quantized pixel values, we include nine
+ * dummy gradients in the calculations.
+ */
+static const float dummyGradients[9][3] = {
+    {0, 0, 0}, {1, 1, 1}, {-1, -1, -1},
+    {0, 0, 1}, {0, 1, 0}, {1, 0, 0},
+    {-1, 0, 0}, {0, -1, 0}, {0, 0, -1}
+};
+
 void GallagherDescriptor::createFeatureVector(QImage image, int border) {
-    if (tileDescriptor != NULL)
+    if (size > 0)
         return;
+    setBorder(border, image.width(), image.height(), LINES);
 
-    this->image = image;
-    this->border = border;
-
-    if (border == Tile::R) {
-        size = image.height();
-        dataExt = image.width() - 1;
-        dataInt = image.width() - 2;
-    } else if (border == Tile::L) {
-        size = image.height();
-        dataExt = 0;
-        dataInt = 1;
-    } else if (border == Tile::B) {
-        size = image.width();
-        dataExt = image.height() - 1;
-        dataInt = image.height() - 2;
-    } else {
-        size = image.width();
-        dataExt = 0;
-        dataInt = 1;
-    }
-
-    tileDescriptor = (float**) calloc(size, sizeof(float*));
-    for (int i = 0; i < size; i++)
-        tileDescriptor[i] = (float*) calloc(3, sizeof(float));
-
-    float **diff = (float**) calloc(size+9, sizeof(float*));
-    for (int i = 0; i < size+9; i++)
-        diff[i] = (float*) calloc(3, sizeof(float));
-
-    // Computing mean difference between descriptors
-    int tx1, ty1, tx2, ty2;
-    for (int i = 0; i < size; i++) {
-        if ((border == Tile::R) || (border == Tile::L)) {
-            tx1 = dataExt;
-            tx2 = dataInt;
-            ty1 = ty2 = i;
-        } else {
-            ty1 = dataExt;
-            ty2 = dataInt;
-            tx1 = tx2 = i;
-        }
-
-        QColor pixel1(image.pixel(tx1, ty1));
-        QColor pixel2(image.pixel(tx2, ty2));
-
-        tileDescriptor[i][0] = ((float) pixel1.red());
-        tileDescriptor[i][1] = ((float) pixel1.green());
-        tileDescriptor[i][2] = ((float) pixel1.blue());
+    // Outer line is the feature vector; the inner one only gives the gradients
+    int outer, innerLine;
+    getLines(border, image.width(), image.height(), outer, innerLine);
+    bool column = (border == Tile::R) || (border == Tile::L);
+    QVarLengthArray<float, 768> inner(3 * size);
+    readLine(image, outer, column, tileDescriptor);
+    readLine(image, innerLine, column, inner.data());
+    computeStatistics(inner.data());
+}
 
-        diff[i][0] = ((float) pixel1.red())   - ((float) pixel2.red());
-        diff[i][1] = ((float) pixel1.green()) - ((float) pixel2.green());
-        diff[i][2] = ((float) pixel1.blue())  - ((float) pixel2.blue());
+void GallagherDescriptor::extractFeatures(TileDescriptor **descriptors, const QImage &image) {
+    PSQP_TRACE_SCOPE("GallagherDescriptor::extractFeatures");
+    // Inner lines of the four borders, only needed for the statistics
+    QVarLengthArray<float, 1536> inner(6 * (image.width() + image.height()));
+    BorderStrips strips;
+    GallagherDescriptor *desc;
+    float *next = inner.data();
+    for (int i = 0; i < 4; i++) {
+        desc = (GallagherDescriptor*) descriptors[i];
+        desc->setBorder(i, image.width(), image.height(), LINES);
+        strips.outer[i] = desc->tileDescriptor;
+        strips.inner[i] = next;
+        next += 3 * desc->size;
     }
+    readBorders(image, strips);
+    for (int i = 0; i < 4; i++)
+        ((GallagherDescriptor*) descriptors[i])->computeStatistics(strips.inner[i]);
+}
 
-    /**
-     * To avoid numerical problems related to the inversion of the covariance,
-     * and the inherent issues of quantized pixel values, we include nine 
-     * dummy gradients in the calculations.
-     */
-    diff[size+0][0] = 0;  diff[size+0][1] = 0;  diff[size+0][2] = 0;
-    diff[size+1][0] = 1;  diff[size+1][1] = 1;  diff[size+1][2] = 1;
-    diff[size+2][0] = -1; diff[size+2][1] = -1; diff[size+2][2] = -1;
-    diff[size+3][0] = 0;  diff[size+3][1] = 0;  diff[size+3][2] = 1;
-    diff[size+4][0] = 0;  diff[size+4][1] = 1;  diff[size+4][2] = 0;
-    diff[size+5][0] = 1;  diff[size+5][1] = 0;  diff[size+5][2] = 0;
-    diff[size+6][0] = -1; diff[size+6][1] = 0;  diff[size+6][2] = 0;
-    diff[size+7][0] = 0;  diff[size+7][1] = -1; diff[size+7][2] = 0;
-    diff[size+8][0] = 0;  diff[size+8][1] = 0;  diff[size+8][2] = -1;
-
+void GallagherDescriptor::computeStatistics(const float *inner) {
+    // Computing mean difference between descriptors
+    float diff[3];
     mean[0] = mean[1] = mean[2] = 0.0;
     for (int i = 0; i < size; i++) {
-        mean[0] += diff[i][0];
-        mean[1] += diff[i][1];
-        mean[2] += diff[i][2];
+        for (int c = 0; c < 3; c++)
+            mean[c] += tileDescriptor[3 * i + c] - inner[3 * i + c];
     }
     mean[0] /= (float)size;
     mean[1] /= (float)size;
     mean[2] /= (float)size;
 
-    // Computing covariance matrix
+    // Computing covariance matrix, dummy gradients included
     float cov[3][3];
     memset(cov,0,sizeof(cov));
     for (int i = 0; i < size+9; i++) {
+        for (int c = 0; c < 3; c++) {
+            if (i < size)
+                diff[c] = tileDescriptor[3 * i + c] - inner[3 * i + c];
+            else
+                diff[c] = dummyGradients[i - size][c];
+        }
         for (int j = 0; j < 3; j++)
             for (int k = 0; k < 3; k++) // color channel
-                cov[j][k] += (diff[i][j]-mean[j])*(diff[i][k]-mean[k]);
+                cov[j][k] += (diff[j]-mean[j])*(diff[k]-mean[k]);
     }
     for (int j = 0; j < 3; j++)
         for (int k = 0; k < 3; k++) // color channel
@@ -131,67 +111,148 @@ void GallagherDescriptor::createFeatureVector(QImage image, int border) {
     for (int i = 0; i < 3; i++)
         for (int j = 0; j < 3; j++)
             invcov[i][j] =  ((cov[(i+1)%3][(j+1)%3] * cov[(i+2)%3][(j+2)%3]) - (cov[(i+1)%3][(j+2)%3]*cov[(i+2)%3][(j+1)%3])) / det;
-}
 
-float GallagherDescriptor::computeDistance(TileDescriptor *otherDescriptor, bool param) {
-    GallagherDescriptor *desc1 = NULL;
-    GallagherDescriptor *desc2 = NULL;
-
-    bool localP, localQ;
-    if (param) {
-        localP = paramP;
-        localQ = paramQ;
-    } else
-        localP = localQ = 1.0;
-
-    if (border == Tile::R || border == Tile::B) {
-        desc1 = this;
-        desc2 = (GallagherDescriptor*) otherDescriptor;
-    } else {
-        desc1 = (GallagherDescriptor*) otherDescriptor;
-        desc2 = this;
-    }
+    /**
+     * The distance from this border to another border y, sum over the pixels
+     * of (y - x - mean)' invcov (y - x - mean), expands, with z = x - center + mean
+     * and y centered on this border's center, into
+     *     <invcov, sum y y'> - 2 sum y . invcov z + sum z' invcov z,
+     * so only invcov z and the last sum are needed from this border, and the
+     * sums of the pixels and of their products when this border is the other one.
+     * Centering keeps the terms small, so they do not cancel out.
+     */
+    for (int j = 0; j < 3; j++)
+        for (int k = 0; k < 3; k++)
+            sinv[j][k] = 0.5 * ((double) invcov[j][k] + (double) invcov[k][j]);
 
-    float **td1 = desc1->getTileDescriptor();
-    float **td2 = desc2->getTileDescriptor();
+    memset(sums, 0, sizeof(sums));
+    memset(moments, 0, sizeof(moments));
+    for (int i = 0; i < size; i++) {
+        for (int j = 0; j < 3; j++) {
+            sums[j] += tileDescriptor[3 * i + j];
+            for (int k = 0; k < 3; k++)
+                moments[j][k] += (double) tileDescriptor[3 * i + j] * tileDescriptor[3 * i + k];
+        }
+    }
+    for (int c = 0; c < 3; c++)
+        center[c] = sums[c] / size;
 
-    float dist = 0.0;
-    float diff1, diff2;
-    float aux1, aux2, aux3, aux4, aux5, aux6;
+    float *premultiplied = tileDescriptor + 3 * size;
+    double shifted[3], product;
+    selfTerm = 0.0;
+    for (int i = 0; i < size; i++) {
+        for (int c = 0; c < 3; c++)
+            shifted[c] = tileDescriptor[3 * i + c] - center[c] + mean[c];
+        for (int j = 0; j < 3; j++) {
+            product = sinv[j][0] * shifted[0] + sinv[j][1] * shifted[1] + sinv[j][2] * shifted[2];
+            premultiplied[3 * i + j] = (float) product;
+            selfTerm += product * shifted[j];
+        }
+    }
+}
 
+float GallagherDescriptor::computeDistance(TileDescriptor *otherDescriptor, bool param) {
     if (size != otherDescriptor->getSize())
         return -1.0;
 
-    diff1 = 0.0;
-    for (int i = 0; i < size; i++) {
-            aux1 = td2[i][0] - td1[i][0] - desc1->getMean(0);
-            aux2 = td2[i][1] - td1[i][1] - desc1->getMean(1);
-            aux3 = td2[i][2] - td1[i][2] - desc1->getMean(2);
+    if (border == Tile::R || border == Tile::B)
+        return getDistanceKernel(param)(this, otherDescriptor);
+    return getDistanceKernel(param)(otherDescriptor, this);
+}
 
-            aux4 = aux1*desc1->getSinv(0,0) + aux2*desc1->getSinv(1,0) + aux3*desc1->getSinv(2,0);
-            aux5 = aux1*desc1->getSinv(0,1) + aux2*desc1->getSinv(1,1) + aux3*desc1->getSinv(2,1);
-            aux6 = aux1*desc1->getSinv(0,2) + aux2*desc1->getSinv(1,2) + aux3*desc1->getSinv(2,2);
+/**
+ * Copy one field to a state buffer, and move past it.
+ * */
+static inline void saveField(char *&state, const void *field, size_t size) {
+    memcpy(state, field, size);
+    state += size;
+}
 
-            diff1 += aux4*aux1 + aux5*aux2 + aux6*aux3;
-    }
+/**
+ * Copy one field from a state buffer, and move past it.
+ * */
+static inline void loadField(const char *&state, void *field, size_t size) {
+    memcpy(field, state, size);
+    state += size;
+}
 
-    diff2 = 0.0;
-    for (int i = 0; i < size; i++) {
-            aux1 = td1[i][0] - td2[i][0] - desc2->getMean(0);
-            aux2 = td1[i][1] - td2[i][1] - desc2->getMean(1);
-            aux3 = td1[i][2] - td2[i][2] - desc2->getMean(2);
+int GallagherDescriptor::getStateSize() {
+    return sizeof(invcov) + sizeof(mean) + sizeof(sinv) + sizeof(center) + sizeof(selfTerm)
+         + sizeof(sums) + sizeof(moments);
+}
 
-            aux4 = aux1*desc2->getSinv(0,0) + aux2*desc2->getSinv(1,0) + aux3*desc2->getSinv(2,0);
-            aux5 = aux1*desc2->getSinv(0,1) + aux2*desc2->getSinv(1,1) + aux3*desc2->getSinv(2,1);
-            aux6 = aux1*desc2->getSinv(0,2) + aux2*desc2->getSinv(1,2) + aux3*desc2->getSinv(2,2);
+void GallagherDescriptor::saveState(char *state) {
+    saveField(state, invcov, sizeof(invcov));
+    saveField(state, mean, sizeof(mean));
+    saveField(state, sinv, sizeof(sinv));
+    saveField(state, center, sizeof(center));
+    saveField(state, &selfTerm, sizeof(selfTerm));
+    saveField(state, sums, sizeof(sums));
+    saveField(state, moments, sizeof(moments));
+}
 
-            diff2 += aux4*aux1 + aux5*aux2 + aux6*aux3;
+void GallagherDescriptor::loadState(const char *state) {
+    loadField(state, invcov, sizeof(invcov));
+    loadField(state, mean, sizeof(mean));
+    loadField(state, sinv, sizeof(sinv));
+    loadField(state, center, sizeof(center));
+    loadField(state, &selfTerm, sizeof(selfTerm));
+    loadField(state, sums, sizeof(sums));
+    loadField(state, moments, sizeof(moments));
+}
+
+TileDescriptor::DistanceKernel GallagherDescriptor::getDistanceKernel(bool param) {
+    if (!param)
+        return &distance<Exponent::ONE, Exponent::ONE>;
+    return kernel;
+}
+
+/**
+ * Mahalanobis distance from border a to border b, from a's precomputed terms
+ * and b's pixels and sums.
+ * */
+double GallagherDescriptor::mahalanobis(GallagherDescriptor *a, GallagherDescriptor *b) {
+    int n = a->size;
+    const double *center = a->center;
+
+    // <invcov, sum y y'> for b's pixels y centered on a's center
+    double centered, quadratic = 0.0;
+    for (int j = 0; j < 3; j++) {
+        for (int k = 0; k < 3; k++) {
+            centered = b->moments[j][k] - center[j] * b->sums[k] - b->sums[j] * center[k]
+                     + n * center[j] * center[k];
+            quadratic += a->sinv[j][k] * centered;
+        }
     }
 
-    diff1 = powf(diff1, localP);
-    diff2 = powf(diff2, localP);
-    dist = diff1 + diff2;
-    dist = powf(dist, localQ);
+    const float *premultiplied = a->tileDescriptor + 3 * n;
+    const float *pixels = b->tileDescriptor;
+    double cross = 0.0;
+    for (int i = 0; i < 3 * n; i += 3) {
+        cross += (pixels[i] - center[0]) * premultiplied[i]
+               + (pixels[i + 1] - center[1]) * premultiplied[i + 1]
+               + (pixels[i + 2] - center[2]) * premultiplied[i + 2];
+    }
+
+    // Clamp the rounding error of a near-zero distance
+    return qMax(0.0, quadratic - 2.0 * cross + a->selfTerm);
+}
+
+template<int P, int Q>
+float GallagherDescriptor::distance(TileDescriptor *first, TileDescriptor *second) {
+    GallagherDescriptor *desc1 = (GallagherDescriptor*) first;
+    GallagherDescriptor *desc2 = (GallagherDescriptor*) second;
+    float localP = desc1->paramP;
+    float localQ = desc1->paramQ;
+
+    // First to second with the first's statistics, and second to first with the second's
+    float diff1 = mahalanobis(desc1, desc2);
+    float diff2 = mahalanobis(desc2, desc1);
+
+    diff1 = Exponent::power<P>(diff1, localP);
+    diff2 = Exponent::power<P>(diff2, localP);
+    float dist = diff1 + diff2;
+    dist = Exponent::power<Q>(dist, localQ);
 
     return dist;
 }
@@ -1,6 +1,8 @@
 #include "tile/tile.h"
 #include "tile/descriptor/colorConversion.h"
 #include "tile/descriptor/pomeranzDescriptor.h"
+#include "tile/descriptor/distanceKernel.h"
+#include "trace.h"
 
 PomeranzDescriptor::PomeranzDescriptor(float paramP, float paramQ) 
                 : TileDescriptor(paramP, paramQ) {
@@ -20,120 +22,91 @@ PomeranzDescriptor::PomeranzDescriptor(float paramP, float paramQ)
      * else if (border == T)
      * 	tileDesc = {0  1  2  3 ;  4  5  6  7}
      */
-    nx2 = 0;
+    kernel = selectDistanceKernel<PomeranzDescriptor>(paramP, paramQ);
 }
 
 PomeranzDescriptor::~PomeranzDescriptor() {
-    for (int i = 0; i < nx2; i++)
-        free(tileDescriptor[i]);
-    free(tileDescriptor);
 }
 
 void PomeranzDescriptor::createFeatureVector(QImage image, int border) {
-    if (tileDescriptor != NULL)
+    if (size > 0)
         return;
+    setBorder(border, image.width(), image.height(), LINES);
+
+    // Outer and inner lines of the border
+    int outer, inner;
+    getLines(border, image.width(), image.height(), outer, inner);
+    bool column = (border == Tile::R) || (border == Tile::L);
+    readLine(image, outer, column, tileDescriptor);
+    readLine(image, inner, column, tileDescriptor + 3 * size);
+    convertToLab();
+}
 
-    this->image = image;
-    this->border = border;
-
-    if (border == Tile::R) {
-        size = image.height();
-        dataExt = image.width() - 1;
-        dataInt = image.width() - 2;
-    } else if (border == Tile::L) {
-        size = image.height();
-        dataExt = 0;
-        dataInt = 1;
-    } else if (border == Tile::B) {
-        size = image.width();
-        dataExt = image.height() - 1;
-        dataInt = image.height() - 2;
-    } else {
-        size = image.width();
-        dataExt = 0;
-        dataInt = 1;
+void PomeranzDescriptor::extractFeatures(TileDescriptor **descriptors, const QImage &image) {
+    PSQP_TRACE_SCOPE("PomeranzDescriptor::extractFeatures");
+    BorderStrips strips;
+    PomeranzDescriptor *desc;
+    for (int i = 0; i < 4; i++) {
+        desc = (PomeranzDescriptor*) descriptors[i];
+        desc->setBorder(i, image.width(), image.height(), LINES);
+        strips.outer[i] = desc->tileDescriptor;
+        strips.inner[i] = desc->tileDescriptor + 3 * desc->size;
     }
-    nx2 = 2 * size;
-
-    tileDescriptor = (float**) calloc(nx2, sizeof(float*));
-    for (int i = 0; i < nx2; i++)
-        tileDescriptor[i] = (float*) calloc(3, sizeof(float));
-
-    int tx1, ty1, tx2, ty2;
-    float tileDescAux[3];
-    for (int i = 0; i < size; i++) {
-        if ((border == Tile::R) || (border == Tile::L)) {
-            tx1 = dataExt;
-            tx2 = dataInt;
-            ty1 = ty2 = i;
-        } else {
-            ty1 = dataExt;
-            ty2 = dataInt;
-            tx1 = tx2 = i;
-        }
-
-        QColor pixel1(image.pixel(tx1, ty1));
-        QColor pixel2(image.pixel(tx2, ty2));
-
-        tileDescAux[0] = ((float) pixel1.red());
-        tileDescAux[1] = ((float) pixel1.green());
-        tileDescAux[2] = ((float) pixel1.blue());
-        ColorConversion::RGBtoLAB(tileDescAux, tileDescriptor[i]);
+    readBorders(image, strips);
+    for (int i = 0; i < 4; i++)
+        ((PomeranzDescriptor*) descriptors[i])->convertToLab();
+}
 
-        tileDescAux[0] = ((float) pixel2.red());
-        tileDescAux[1] = ((float) pixel2.green());
-        tileDescAux[2] = ((float) pixel2.blue());
-        ColorConversion::RGBtoLAB(tileDescAux, tileDescriptor[size + i]);
-    }
+void PomeranzDescriptor::convertToLab() {
+    ColorConversion::RGBtoLAB(tileDescriptor, tileDescriptor, LINES * size);
 }
 
 float PomeranzDescriptor::computeDistance(TileDescriptor *otherDescriptor, bool param) {
-    PomeranzDescriptor *desc1 = NULL;
-    PomeranzDescriptor *desc2 = NULL;
+    if (size != otherDescriptor->getSize())
+        return -1.0;
 
-    bool localP, localQ;
-    if (param) {
-        localP = paramP;
-        localQ = paramQ;
-    } else
-        localP = localQ = 1.0;
-    
+    if (border == Tile::R || border == Tile::B)
+        return getDistanceKernel(param)(this, otherDescriptor);
+    return getDistanceKernel(param)(otherDescriptor, this);
+}
 
-    if (border == Tile::R || border == Tile::B) {
-        desc1 = this;
-        desc2 = (PomeranzDescriptor*) otherDescriptor;
-    } else {
-        desc1 = (PomeranzDescriptor*) otherDescriptor;
-        desc2 = this;
-    }
+TileDescriptor::DistanceKernel PomeranzDescriptor::getDistanceKernel(bool param) {
+    if (!param)
+        return &distance<Exponent::ONE, Exponent::ONE>;
+    return kernel;
+}
 
-    float **td1 = desc1->getTileDescriptor();
-    float **td2 = desc2->getTileDescriptor();
+template<int P, int Q>
+float PomeranzDescriptor::distance(TileDescriptor *first, TileDescriptor *second) {
+    PomeranzDescriptor *desc1 = (PomeranzDescriptor*) first;
+    PomeranzDescriptor *desc2 = (PomeranzDescriptor*) second;
+    int size = desc1->size;
+    float localP = desc1->paramP;
+    float localQ = desc1->paramQ;
+
+    float *td1 = desc1->getTileDescriptor();
+    float *td2 = desc2->getTileDescriptor();
+    // Inner lines
+    float *in1 = td1 + 3 * size;
+    float *in2 = td2 + 3 * size;
 
     float dist = 0.0;
     float pred1, pred2;
-
-    if (size != otherDescriptor->getSize())
-        return -1.0;
-
     float aux;
 
     aux = 0.0;
     pred1 = 0.0;
     pred2 = 0.0;
-    for (int i = 0; i < size; i++) {
-        for (int j = 0; j < 3; j++) {
-            aux = fabsf(td1[i][j] + td1[i][j] - td1[size + i][j] - td2[i][j]);
-            pred1 += powf(aux, localP);
-
-            aux = fabsf(td2[i][j] + td2[i][j] - td1[i][j] - td2[size + i][j]);
-            pred2 += powf(aux, localP);
+    for (int i = 0; i < 3 * size; i++) {
+        aux = fabsf(td1[i] + td1[i] - in1[i] - td2[i]);
+        pred1 += Exponent::power<P>(aux, localP);
 
-        }
+        aux = fabsf(td2[i] + td2[i] - td1[i] - in2[i]);
+        pred2 += Exponent::power<P>(aux, localP);
     }
     pred1 /= (float) size;
     pred2 /= (float) size;
-    dist = powf(pred1, localQ) + powf(pred2, localQ);
+    dist = Exponent::power<Q>(pred1, localQ) + Exponent::power<Q>(pred2, localQ);
 
     return dist;
 }
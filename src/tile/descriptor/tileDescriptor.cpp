@@ -0,0 +1,78 @@
+#include "tile/tile.h"
+#include "tile/descriptor/tileDescriptor.h"
+
+void TileDescriptor::setBorder(int border, int width, int height, int lines) {
+    this->border = border;
+    // Borders R and L run along the tile's height, B and T along its width
+    if ((border == Tile::R) || (border == Tile::L))
+        size = height;
+    else
+        size = width;
+    allocateBuffer(lines);
+}
+
+void TileDescriptor::restore(int border, int width, int height, const char *state) {
+    if (tileDescriptor == NULL)
+        qFatal("Call TileDescriptor::setBuffer before TileDescriptor::restore.\n");
+    // The buffer is set, so nothing is allocated
+    setBorder(border, width, height, 0);
+    loadState(state);
+}
+
+void TileDescriptor::getLines(int border, int width, int height, int &outer, int &inner) {
+    if (border == Tile::R) {
+        outer = width - 1;
+        inner = width - 2;
+    } else if (border == Tile::B) {
+        outer = height - 1;
+        inner = height - 2;
+    } else {
+        outer = 0;
+        inner = 1;
+    }
+}
+
+/**
+ * Store one pixel as floats (red, green, blue).
+ * */
+static inline void storePixel(QRgb pixel, float *rgb) {
+    rgb[0] = (float) qRed(pixel);
+    rgb[1] = (float) qGreen(pixel);
+    rgb[2] = (float) qBlue(pixel);
+}
+
+void TileDescriptor::readBorders(const QImage &image, BorderStrips &strips) {
+    int width = image.width();
+    int height = image.height();
+    const QRgb *pixels;
+    float *row;
+    for (int y = 0; y < height; y++) {
+        pixels = (const QRgb*) image.constScanLine(y);
+
+        // Both columns of the right and left borders
+        storePixel(pixels[width - 1], strips.outer[Tile::R] + 3 * y);
+        storePixel(pixels[width - 2], strips.inner[Tile::R] + 3 * y);
+        storePixel(pixels[0], strips.outer[Tile::L] + 3 * y);
+        storePixel(pixels[1], strips.inner[Tile::L] + 3 * y);
+
+        // Whole rows of the bottom and top borders
+        row = NULL;
+        if (y == 0)
+            row = strips.outer[Tile::T];
+        else if (y == 1)
+            row = strips.inner[Tile::T];
+        if (row != NULL) {
+            for (int x = 0; x < width; x++)
+                storePixel(pixels[x], row + 3 * x);
+        }
+        row = NULL;
+        if (y == height - 1)
+            row = strips.outer[Tile::B];
+        else if (y == height - 2)
+            row = strips.inner[Tile::B];
+        if (row != NULL) {
+            for (int x = 0; x < width; x++)
+                storePixel(pixels[x], row + 3 * x);
+        }
+    }
+}
@@ -0,0 +1,197 @@
+#include "tile/puzzleFile.h"
+#include "tile/tiledImage.h"
+
+/**
+ * Magic number at the start of a puzzle file.
+ * */
+static const char magicNumber[8] = {'P', 'S', 'Q', 'P', 'U', 'Z', 'Z', '\0'};
+
+/**
+ * Write zeros up to an offset of the file.
+ * */
+static void writePadding(QFile &file, quint64 offset) {
+    if ((quint64) file.pos() < offset)
+        file.write(QByteArray((int) (offset - file.pos()), '\0'));
+}
+
+quint64 PuzzleFile::align(quint64 offset) {
+    return (offset + PUZZLE_ALIGNMENT - 1) & ~((quint64) PUZZLE_ALIGNMENT - 1);
+}
+
+void PuzzleFile::save(QString fileName, TiledImage *tiledImage, int thumbnailSize) {
+    Tile *tile = tiledImage->getTile(0);
+    int ntiles = tiledImage->getNCols() * tiledImage->getNRows();
+    const DescriptorRegistry::entry *type = tile->getDescriptorType();
+    if (type == NULL)
+        qFatal("Call TiledImage::setDescriptor before PuzzleFile::save.\n");
+    TileDescriptor **desc = tile->getDescriptors();
+    int width = tile->getWidth();
+    int height = tile->getHeight();
+
+    header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, magicNumber, sizeof(h.magic));
+    h.version = VERSION;
+    h.ncols = tiledImage->getNCols();
+    h.nrows = tiledImage->getNRows();
+    h.tileWidth = width;
+    h.tileHeight = height;
+    if (thumbnailSize > 0) {
+        // Longest side of the thumbnails is thumbnailSize, keeping the tiles' aspect
+        h.thumbnailWidth = qMax(1, qRound(width * thumbnailSize / (double) qMax(width, height)));
+        h.thumbnailHeight = qMax(1, qRound(height * thumbnailSize / (double) qMax(width, height)));
+    }
+    h.featureSize = Tile::getFeatureSize(type, width, height);
+    h.stateSize = desc[0]->getStateSize();
+    h.paramP = desc[0]->getParamP();
+    h.paramQ = desc[0]->getParamQ();
+    strncpy(h.descriptor, type->name, sizeof(h.descriptor) - 1);
+    h.featuresOffset = align(sizeof(h));
+    h.statesOffset = align(h.featuresOffset + (quint64) ntiles * h.featureSize * sizeof(float));
+    h.thumbnailsOffset = align(h.statesOffset + (quint64) ntiles * 4 * h.stateSize);
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        qFatal("Could not write puzzle file %s: %s\n", qPrintable(fileName),
+               qPrintable(file.errorString()));
+    file.write((const char*) &h, sizeof(h));
+
+    // Features of the four borders of each tile, padded as in a tiled image's arena
+    writePadding(file, h.featuresOffset);
+    int bufferSize;
+    for (int i = 0; i < ntiles; i++) {
+        desc = tiledImage->getTile(i)->getDescriptors();
+        for (int j = 0; j < 4; j++) {
+            bufferSize = TileDescriptor::getBufferSize(type->lines, desc[j]->getSize());
+            file.write((const char*) desc[j]->getTileDescriptor(), bufferSize * sizeof(float));
+        }
+    }
+
+    writePadding(file, h.statesOffset);
+    char *state = new char[qMax(1, (int) h.stateSize)];
+    for (int i = 0; i < ntiles; i++) {
+        desc = tiledImage->getTile(i)->getDescriptors();
+        for (int j = 0; j < 4; j++) {
+            desc[j]->saveState(state);
+            file.write(state, h.stateSize);
+        }
+    }
+    delete[] state;
+
+    if (thumbnailSize > 0) {
+        writePadding(file, h.thumbnailsOffset);
+        QImage thumbnail;
+        for (int i = 0; i < ntiles; i++) {
+            thumbnail = tiledImage->getTile(i)->getView().scaled(h.thumbnailWidth, h.thumbnailHeight,
+                        Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            if (thumbnail.format() != QImage::Format_RGB32)
+                thumbnail = thumbnail.convertToFormat(QImage::Format_RGB32);
+            for (int y = 0; y < h.thumbnailHeight; y++)
+                file.write((const char*) thumbnail.constScanLine(y), h.thumbnailWidth * sizeof(QRgb));
+        }
+    }
+    file.close();
+
+    qDebug() << "Puzzle file: " << fileName << "(" << ntiles << "tiles )";
+}
+
+PuzzleFile::PuzzleFile(QString fileName): file(fileName) {
+    if (!file.open(QIODevice::ReadOnly))
+        qFatal("Could not open puzzle file %s: %s\n", qPrintable(fileName),
+               qPrintable(file.errorString()));
+    qint64 size = file.size();
+    if (size < (qint64) sizeof(header))
+        qFatal("%s is not a puzzle file.\n", qPrintable(fileName));
+    data = file.map(0, size);
+    if (data == NULL)
+        qFatal("Could not map puzzle file %s: %s\n", qPrintable(fileName),
+               qPrintable(file.errorString()));
+    info = (const header*) data;
+
+    if (memcmp(info->magic, magicNumber, sizeof(info->magic)) != 0)
+        qFatal("%s is not a puzzle file.\n", qPrintable(fileName));
+    if (info->version != VERSION)
+        qFatal("Puzzle file %s has version %d, expected %d.\n", qPrintable(fileName),
+               info->version, VERSION);
+    if (info->ncols <= 0 || info->nrows <= 0 || info->tileWidth < 2 || info->tileHeight < 2
+            || info->featureSize <= 0 || info->stateSize < 0
+            || info->descriptor[sizeof(info->descriptor) - 1] != '\0')
+        qFatal("Puzzle file %s is corrupted.\n", qPrintable(fileName));
+
+    // Every section must be aligned and within the file
+    quint64 ntiles = (quint64) info->ncols * info->nrows;
+    quint64 end = info->thumbnailsOffset
+            + ntiles * info->thumbnailWidth * info->thumbnailHeight * sizeof(QRgb);
+    if (info->featuresOffset % PUZZLE_ALIGNMENT != 0 || info->statesOffset % PUZZLE_ALIGNMENT != 0
+            || info->thumbnailsOffset % PUZZLE_ALIGNMENT != 0
+            || info->featuresOffset + ntiles * info->featureSize * sizeof(float) > info->statesOffset
+            || info->statesOffset + ntiles * 4 * info->stateSize > (quint64) size
+            || (info->thumbnailWidth > 0 && end > (quint64) size))
+        qFatal("Puzzle file %s is truncated or corrupted.\n", qPrintable(fileName));
+}
+
+PuzzleFile::~PuzzleFile() {
+    file.unmap(data);
+    file.close();
+}
+
+int PuzzleFile::getNCols() {
+    return info->ncols;
+}
+
+int PuzzleFile::getNRows() {
+    return info->nrows;
+}
+
+int PuzzleFile::getTileWidth() {
+    return info->tileWidth;
+}
+
+int PuzzleFile::getTileHeight() {
+    return info->tileHeight;
+}
+
+QString PuzzleFile::getDescriptor() {
+    return QString(info->descriptor);
+}
+
+float PuzzleFile::getParamP() {
+    return info->paramP;
+}
+
+float PuzzleFile::getParamQ() {
+    return info->paramQ;
+}
+
+int PuzzleFile::getFeatureSize() {
+    return info->featureSize;
+}
+
+int PuzzleFile::getStateSize() {
+    return info->stateSize;
+}
+
+const float *PuzzleFile::getFeatures() {
+    return (const float*) (data + info->featuresOffset);
+}
+
+const char *PuzzleFile::getStates() {
+    return (const char*) (data + info->statesOffset);
+}
+
+QImage PuzzleFile::getThumbnails() {
+    if (info->thumbnailWidth <= 0 || info->thumbnailHeight <= 0)
+        return QImage();
+    // Read-only constructor: the image shares the mapped pixels
+    return QImage((const uchar*) data + info->thumbnailsOffset, info->thumbnailWidth,
+                  info->thumbnailHeight * info->ncols * info->nrows,
+                  info->thumbnailWidth * sizeof(QRgb), QImage::Format_RGB32);
+}
+
+int PuzzleFile::getThumbnailWidth() {
+    return info->thumbnailWidth;
+}
+
+int PuzzleFile::getThumbnailHeight() {
+    return info->thumbnailHeight;
+}
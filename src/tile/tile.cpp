@@ -1,40 +1,78 @@
 #include "tile/tile.h"
-#include "tile/descriptor/pomeranzDescriptor.h"
-#include "tile/descriptor/gallagherDescriptor.h"
 
 Tile::Tile() {
+    descriptors = NULL;
+    descriptorType = NULL;
 }
 
 Tile::~Tile() {
-    if (descriptors != NULL)
+    if (descriptors != NULL) {
         for (int i = 0; i < 4; i++)
             delete descriptors[i];
         delete[] descriptors;
+    }
+}
+
+int Tile::getFeatureSize(const DescriptorRegistry::entry *desc, int width, int height) {
+    return 2 * TileDescriptor::getBufferSize(desc->lines, height)
+         + 2 * TileDescriptor::getBufferSize(desc->lines, width);
 }
 
-void Tile::createDescriptors(QString desc, float paramP, float paramQ) {
-    if (image.isNull())
+void Tile::createDescriptors(const DescriptorRegistry::entry *desc, float paramP, float paramQ,
+                             float *features) {
+    if (!hasImage())
         qFatal("Call Tile::setImage before Tile::createDescriptors.\n");
 
+    // Descriptors read the pixels directly from the source image
+    createDescriptors(desc, paramP, paramQ, features, getView());
+}
+
+void Tile::createDescriptors(const DescriptorRegistry::entry *desc, float paramP, float paramQ,
+                             float *features, const QImage &pixels) {
+    allocateDescriptors(desc, paramP, paramQ, features);
+    desc->extract(descriptors, pixels);
+}
+
+void Tile::restoreDescriptors(const DescriptorRegistry::entry *desc, float paramP, float paramQ,
+                              const float *features, const char *states) {
+    if (features == NULL)
+        qFatal("Tile::restoreDescriptors needs the features of the four borders.\n");
+
+    // Descriptors only read their features, so they can live in a read-only mapping
+    allocateDescriptors(desc, paramP, paramQ, (float*) features);
+    int stateSize = descriptors[0]->getStateSize();
+    for (int i = 0; i < 4; i++)
+        descriptors[i]->restore(i, getWidth(), getHeight(), states + i * stateSize);
+}
+
+void Tile::allocateDescriptors(const DescriptorRegistry::entry *desc, float paramP, float paramQ,
+                               float *features) {
+    if (descriptors != NULL) {
+        for (int i = 0; i < 4; i++)
+            delete descriptors[i];
+        delete[] descriptors;
+    }
+
+    descriptorType = desc;
     descriptors = new TileDescriptor*[4];
     for (int i = 0; i < 4; i++) {
-        if (desc == "Gallagher") {
-            descriptors[i] = new GallagherDescriptor(paramP, paramQ);
-        } else {
-            descriptors[i] = new PomeranzDescriptor(paramP, paramQ);
+        descriptors[i] = desc->create(paramP, paramQ);
+        // Borders R and L run along the tile's height, B and T along its width
+        if (features != NULL) {
+            descriptors[i]->setBuffer(features);
+            features += TileDescriptor::getBufferSize(desc->lines, (i < 2) ? getHeight() : getWidth());
         }
     }
-
-    for (int i = 0; i < 4; i++)
-        descriptors[i]->createFeatureVector(image, i);
 }
 
 TileDescriptor **Tile::getDescriptors() {
-    if (image.isNull())
-        return NULL;
     return descriptors;
 }
 
+const DescriptorRegistry::entry *Tile::getDescriptorType() {
+    return descriptorType;
+}
+
 double Tile::computeDistance(Tile *t, int border) {
     int otherBorder = 0;
     if ((border == R) || (border == B))
@@ -45,24 +83,71 @@ double Tile::computeDistance(Tile *t, int border) {
             (t->getDescriptors()[otherBorder]));
 }
 
-void Tile::setImage(QImage image) {
-    if (image.isNull())
+void Tile::setImage(const QImage &source, const QRect &rect) {
+    if (source.isNull())
         return;
-    this->image = image;
+    if (source.format() != QImage::Format_RGB32 && source.format() != QImage::Format_ARGB32)
+        qFatal("Tile::setImage needs a source image with 32 bits per pixel.\n");
+    this->source = source;
+    this->file = QString();
+    this->rect = rect;
+}
+
+void Tile::setImage(const QString &file, const QRect &rect) {
+    this->source = QImage();
+    this->file = file;
+    this->rect = rect;
+}
+
+void Tile::setSize(int width, int height) {
+    this->source = QImage();
+    this->file = QString();
+    this->rect = QRect(0, 0, width, height);
+}
+
+void Tile::setThumbnail(const QImage &thumbnail) {
+    this->thumbnail = thumbnail;
+}
+
+bool Tile::hasImage() {
+    return !source.isNull() || !file.isEmpty();
 }
 
 int Tile::getHeight() {
-    if (image.isNull())
-        return 0;
-    return image.height();
+    return rect.height();
 }
 
 int Tile::getWidth() {
-    if (image.isNull())
-        return 0;
-    return image.width();
+    return rect.width();
 }
 
 QImage Tile::getImage() {
-    return image;
+    if (!file.isEmpty()) {
+        // Decode just this tile's region again
+        QImageReader reader(file);
+        reader.setClipRect(rect);
+        QImage image = reader.read();
+        if (image.format() != QImage::Format_RGB32 && image.format() != QImage::Format_ARGB32)
+            image = image.convertToFormat(QImage::Format_RGB32);
+        return image;
+    }
+    if (source.isNull()) {
+        if (thumbnail.isNull())
+            return QImage();
+        return thumbnail.scaled(rect.size());
+    }
+    return source.copy(rect);
+}
+
+QImage Tile::getView() {
+    if (!file.isEmpty() || source.isNull())
+        return getImage();
+    return getView(source, rect);
+}
+
+QImage Tile::getView(const QImage &source, const QRect &rect) {
+    // Read-only constructor: the view shares the source's pixels
+    const uchar *bits = source.constBits() + rect.y() * source.bytesPerLine()
+                      + rect.x() * sizeof(QRgb);
+    return QImage(bits, rect.width(), rect.height(), source.bytesPerLine(), source.format());
 }
@@ -1,37 +1,240 @@
 #include <sstream>
+#include <QtConcurrentMap>
 
 #include "tile/tiledImage.h"
+#include "trace.h"
+
+/**
+ * Struct to pass one tile image's decoding to a thread.
+ */
+struct tileLoad {
+    QString file;
+    QImage image;
+};
+
+/**
+ * Decode one tile image (runs concurrently).
+ * */
+void loadTileImage(tileLoad &load) {
+    PSQP_TRACE_SCOPE("TiledImage::loadTileImage");
+    load.image = QImage(load.file);
+    if (load.image.isNull())
+        return;
+    if (load.image.format() != QImage::Format_RGB32 && load.image.format() != QImage::Format_ARGB32)
+        load.image = load.image.convertToFormat(QImage::Format_RGB32);
+}
+
+/**
+ * Struct to pass one tile's descriptors creation to a thread.
+ */
+struct descriptorTask {
+    Tile *tile;
+    const DescriptorRegistry::entry *type;
+    float paramP, paramQ;
+    float *features;
+    QImage pixels;
+};
+
+/**
+ * Create one tile's descriptors (runs concurrently), from the given
+ * pixels or else from the tile's own image.
+ * */
+void createTileDescriptors(descriptorTask &task) {
+    PSQP_TRACE_SCOPE("Tile::createDescriptors");
+    if (task.pixels.isNull())
+        task.tile->createDescriptors(task.type, task.paramP, task.paramQ, task.features);
+    else
+        task.tile->createDescriptors(task.type, task.paramP, task.paramQ, task.features,
+                                     task.pixels);
+}
 
 TiledImage::TiledImage(QImage *image, int ncols, int nrows) {
     this->ncols = ncols;
     this->nrows = nrows;
-    ntiles = ncols * nrows;
+    setSize(image->width(), image->height());
 
-    tileH = floor(image->height() / (double) nrows);
-    tileW = floor(image->width() / (double) ncols);
+    // Convert the whole image at once; tiles are views of it, sharing its pixels
+    QImage source = *image;
+    if (source.format() != QImage::Format_RGB32 && source.format() != QImage::Format_ARGB32)
+        source = source.convertToFormat(QImage::Format_RGB32);
 
-    qDebug() << "Image size: " << image->width() << "x" << image->height();
-    qDebug() << "Tile size: " << tileW << "x" << tileH;
-    qDebug() << "# of tiles: " << "(" << ncols << "*" << nrows << ") = "
-            << (ncols * nrows);
+    int index = 0;
+    for (int i = 0; i < nrows; i++) {
+        for (int j = 0; j < ncols; j++, index++) {
+            tiles[index].setImage(source, QRect(j * tileW, i * tileH, tileW, tileH));
+        }
+    }
+}
+
+TiledImage::TiledImage(QString imageFile, int ncols, int nrows) {
+    this->ncols = ncols;
+    this->nrows = nrows;
+    this->imageFile = imageFile;
+
+    if (!canStream(imageFile))
+        qFatal("Cannot stream %s: its format cannot decode a region.\n", qPrintable(imageFile));
+    QImageReader reader(imageFile);
+    QSize size = reader.size();
+    if (!size.isValid())
+        qFatal("Could not read the size of %s: %s\n", qPrintable(imageFile),
+               qPrintable(reader.errorString()));
+    setSize(size.width(), size.height());
 
-    tiles = new Tile[ntiles];
     int index = 0;
     for (int i = 0; i < nrows; i++) {
         for (int j = 0; j < ncols; j++, index++) {
-            tiles[index].setImage(image->copy(j * tileW, i * tileH, tileW, tileH));
+            tiles[index].setImage(imageFile, QRect(j * tileW, i * tileH, tileW, tileH));
         }
     }
+}
+
+TiledImage::TiledImage(QStringList tileFiles, int ncols, int nrows) {
+    this->ncols = ncols;
+    this->nrows = nrows;
+    if (tileFiles.count() != ncols * nrows)
+        qFatal("The puzzle needs %d tiles, %d were given.\n", ncols * nrows, tileFiles.count());
+
+    QVector<tileLoad> loads(tileFiles.count());
+    for (int i = 0; i < loads.size(); i++)
+        loads[i].file = tileFiles[i];
+    QtConcurrent::blockingMap(loads, loadTileImage);
+
+    // Every tile must have been decoded, with the same size
+    for (int i = 0; i < loads.size(); i++) {
+        if (loads[i].image.isNull())
+            qFatal("Could not decode tile %s.\n", qPrintable(loads[i].file));
+        if (loads[i].image.width() != loads[0].image.width()
+                || loads[i].image.height() != loads[0].image.height())
+            qFatal("Tile %s is %dx%d, but %s is %dx%d.\n", qPrintable(loads[i].file),
+                   loads[i].image.width(), loads[i].image.height(), qPrintable(loads[0].file),
+                   loads[0].image.width(), loads[0].image.height());
+    }
+    setSize(ncols * loads[0].image.width(), nrows * loads[0].image.height());
+
+    for (int i = 0; i < ntiles; i++)
+        tiles[i].setImage(loads[i].image, QRect(0, 0, tileW, tileH));
+}
+
+TiledImage::TiledImage(PuzzleFile *puzzle) {
+    this->ncols = puzzle->getNCols();
+    this->nrows = puzzle->getNRows();
+    setSize(ncols * puzzle->getTileWidth(), nrows * puzzle->getTileHeight());
+    this->puzzle = puzzle;
+
+    const DescriptorRegistry::entry *type = DescriptorRegistry::find(puzzle->getDescriptor());
+    if (type == NULL)
+        qFatal("Unknown descriptor %s.\n", qPrintable(puzzle->getDescriptor()));
+    int tileSize = Tile::getFeatureSize(type, tileW, tileH);
+    if (puzzle->getFeatureSize() != tileSize)
+        qFatal("Puzzle file has %d floats of features per tile, %s needs %d.\n",
+               puzzle->getFeatureSize(), type->name, tileSize);
+    TileDescriptor *probe = type->create(puzzle->getParamP(), puzzle->getParamQ());
+    int stateSize = probe->getStateSize();
+    delete probe;
+    if (puzzle->getStateSize() != stateSize)
+        qFatal("Puzzle file has %d bytes of state per border, %s needs %d.\n",
+               puzzle->getStateSize(), type->name, stateSize);
+    qDebug() << "Descriptor: " << type->name;
+
+    // Features stay in the mapped file; only the descriptor objects are created
+    const float *mapped = puzzle->getFeatures();
+    const char *states = puzzle->getStates();
+    QImage thumbnails = puzzle->getThumbnails();
+    int thumbnailW = puzzle->getThumbnailWidth();
+    int thumbnailH = puzzle->getThumbnailHeight();
+    for (int i = 0; i < ntiles; i++) {
+        tiles[i].setSize(tileW, tileH);
+        if (!thumbnails.isNull())
+            tiles[i].setThumbnail(Tile::getView(thumbnails, QRect(0, i * thumbnailH, thumbnailW, thumbnailH)));
+        tiles[i].restoreDescriptors(type, puzzle->getParamP(), puzzle->getParamQ(),
+                                    mapped + (size_t) i * tileSize,
+                                    states + (size_t) i * 4 * puzzle->getStateSize());
+    }
+}
 
+bool TiledImage::canStream(QString imageFile) {
+    return QImageReader(imageFile).supportsOption(QImageIOHandler::ClipRect);
+}
+
+bool TiledImage::isPreCut(QString path) {
+    QFileInfo info(path);
+    return info.isDir() || info.suffix().toLower() == TILE_MANIFEST_SUFFIX;
+}
+
+QStringList TiledImage::listTileFiles(QString path) {
+    QStringList files;
+    QFileInfo info(path);
+    if (info.isDir()) {
+        QStringList filters;
+        QList<QByteArray> formats = QImageReader::supportedImageFormats();
+        for (int i = 0; i < formats.size(); i++)
+            filters << "*." + QString(formats[i]);
+        QDir dir(path);
+        QStringList names = dir.entryList(filters, QDir::Files, QDir::Name);
+        for (int i = 0; i < names.size(); i++)
+            files << dir.filePath(names[i]);
+        return files;
+    }
+
+    QFile manifest(path);
+    if (!manifest.open(QIODevice::ReadOnly | QIODevice::Text))
+        qFatal("Could not open tile manifest %s.\n", qPrintable(path));
+    QDir dir(info.absolutePath());
+    QTextStream in(&manifest);
+    QString line;
+    while (!in.atEnd()) {
+        line = in.readLine().trimmed();
+        if (!line.isEmpty())
+            files << dir.filePath(line);
+    }
+    return files;
+}
+
+void TiledImage::setSize(int width, int height) {
+    ntiles = ncols * nrows;
+
+    tileH = floor(height / (double) nrows);
+    tileW = floor(width / (double) ncols);
+
+    qDebug() << "Image size: " << width << "x" << height;
+    qDebug() << "Tile size: " << tileW << "x" << tileH;
+    qDebug() << "# of tiles: " << "(" << ncols << "*" << nrows << ") = "
+            << (ncols * nrows);
+
+    tiles = new Tile[ntiles];
     tileTranslation = new int[ntiles];
+    permutBuffer = new int[ntiles];
     for (int i = 0; i < ntiles; i++) {
         tileTranslation[i] = i;
     }
+    canUndo = false;
+
+    features = NULL;
+    puzzle = NULL;
+    directAccuracy = -1.0;
+    neighborAccuracy = -1.0;
+}
+
+QImage TiledImage::readBand(int first, int rows) {
+    PSQP_TRACE_SCOPE("TiledImage::readBand");
+    QImageReader reader(imageFile);
+    reader.setClipRect(QRect(0, first * tileH, ncols * tileW, rows * tileH));
+    QImage band = reader.read();
+    if (band.isNull())
+        qFatal("Could not decode %s: %s\n", qPrintable(imageFile),
+               qPrintable(reader.errorString()));
+    if (band.format() != QImage::Format_RGB32 && band.format() != QImage::Format_ARGB32)
+        band = band.convertToFormat(QImage::Format_RGB32);
+    return band;
 }
 
 TiledImage::~TiledImage() {
     delete[] tiles;
     delete[] tileTranslation;
+    delete[] permutBuffer;
+    qFreeAligned(features);
+    // Descriptors of a puzzle file point into its mapping, so it goes after the tiles
+    delete puzzle;
 }
 
 
@@ -39,6 +242,10 @@ Tile *TiledImage::getTiles() {
     return tiles;
 }
 
+Tile *TiledImage::getTile(int position) {
+    return &tiles[tileTranslation[position]];
+}
+
 int TiledImage::getNCols() {
     return ncols;
 }
@@ -48,19 +255,67 @@ int TiledImage::getNRows() {
 }
 
 void TiledImage::setDescriptor(QString desc, double param_p, double param_q) {
+    PSQP_TRACE_SCOPE("TiledImage::setDescriptor");
+    if (puzzle != NULL) {
+        if (desc != puzzle->getDescriptor() || (float) param_p != puzzle->getParamP()
+                || (float) param_q != puzzle->getParamQ())
+            qFatal("The puzzle file was converted with %s (p = %g, q = %g); convert it again "
+                   "to use %s (p = %g, q = %g).\n", qPrintable(puzzle->getDescriptor()),
+                   puzzle->getParamP(), puzzle->getParamQ(), qPrintable(desc), param_p, param_q);
+        return;
+    }
+
     qDebug() << "Descriptor: " << desc;
+    const DescriptorRegistry::entry *type = DescriptorRegistry::find(desc);
+    if (type == NULL)
+        qFatal("Unknown descriptor %s.\n", qPrintable(desc));
 
-    for (int i = 0; i < ntiles; i++)
-        tiles[i].createDescriptors(desc, param_p, param_q);
+    // One aligned arena holds every tile's features
+    int tileSize = Tile::getFeatureSize(type, tileW, tileH);
+    float *arena = (float*) qMallocAligned((size_t) ntiles * tileSize * sizeof(float), 16);
+    QVector<descriptorTask> tasks(ntiles);
+    for (int i = 0; i < ntiles; i++) {
+        tasks[i].tile = &tiles[i];
+        tasks[i].type = type;
+        tasks[i].paramP = param_p;
+        tasks[i].paramQ = param_q;
+        tasks[i].features = arena + (size_t) i * tileSize;
+    }
+    if (imageFile.isEmpty()) {
+        QtConcurrent::blockingMap(tasks, createTileDescriptors);
+    } else {
+        // Decode a band of rows of tiles at a time, and keep only their features
+        int rowsPerBand = qMax(1, STREAM_BAND_PIXELS / (ncols * tileW * tileH));
+        int rows;
+        QImage band;
+        QVector<descriptorTask> bandTasks;
+        for (int first = 0; first < nrows; first += rowsPerBand) {
+            rows = qMin(rowsPerBand, nrows - first);
+            bandTasks.clear();
+            band = readBand(first, rows);
+            for (int i = 0; i < rows * ncols; i++) {
+                // Tiles keep their original order, so the band's tiles are consecutive
+                bandTasks.append(tasks[first * ncols + i]);
+                bandTasks.last().pixels = Tile::getView(band,
+                        QRect((i % ncols) * tileW, (i / ncols) * tileH, tileW, tileH));
+            }
+            QtConcurrent::blockingMap(bandTasks, createTileDescriptors);
+        }
+        // The views must go before the band they look into
+        bandTasks.clear();
+    }
+
+    // Previous descriptors were replaced, so their arena can go
+    qFreeAligned(features);
+    features = arena;
 }
 
 void TiledImage::permutTiles(int *perm) {
-    Tile *auxTiles = new Tile[ntiles];
-    int *auxTranslation = new int[ntiles];
-
     // Generate random permutation
+    QVector<int> randPerm;
     if (perm == NULL) {
-        perm = new int[ntiles];
+        randPerm.resize(ntiles);
+        perm = randPerm.data();
         int auxNum, randNum;
 
         for (int i = 0; i < ntiles; i++)
@@ -75,13 +330,25 @@ void TiledImage::permutTiles(int *perm) {
             perm[randNum] = auxNum;
         }
     }
-    // apply permutation
-    for (int i = 0; i < ntiles; i++) {
-        auxTiles[i] = tiles[perm[i]];
-        auxTranslation[i] = tileTranslation[perm[i]];
-    }
-    tiles = auxTiles;
-    tileTranslation = auxTranslation;    
+
+    // Compose with the current translation, which stays in the buffer to undo: tiles never move
+    for (int i = 0; i < ntiles; i++)
+        permutBuffer[i] = tileTranslation[perm[i]];
+    qSwap(tileTranslation, permutBuffer);
+    canUndo = true;
+    // The metrics are those of the previous permutation
+    directAccuracy = -1.0;
+    neighborAccuracy = -1.0;
+}
+
+bool TiledImage::undoPermutation() {
+    if (!canUndo)
+        return false;
+    qSwap(tileTranslation, permutBuffer);
+    canUndo = false;
+    directAccuracy = -1.0;
+    neighborAccuracy = -1.0;
+    return true;
 }
 
 void TiledImage::computeMetrics() {
@@ -91,7 +358,8 @@ void TiledImage::computeMetrics() {
             correctDirect++;
     }
 
-    qDebug() << "Direct: " << ((correctDirect / (double) ntiles) * 100.0);
+    directAccuracy = (correctDirect / (double) ntiles) * 100.0;
+    qDebug() << "Direct: " << directAccuracy;
 
     int iaux, jaux;
     int correctNgb = 0;
@@ -129,5 +397,14 @@ void TiledImage::computeMetrics() {
         }
     }
 
-    qDebug() << "Neighbor: " << ((correctNgb / (double) contTotal) * 100.0);
+    neighborAccuracy = (contTotal > 0) ? (correctNgb / (double) contTotal) * 100.0 : 100.0;
+    qDebug() << "Neighbor: " << neighborAccuracy;
+}
+
+double TiledImage::getDirectAccuracy() {
+    return directAccuracy;
+}
+
+double TiledImage::getNeighborAccuracy() {
+    return neighborAccuracy;
 }
@@ -0,0 +1,101 @@
+#include "trace.h"
+
+volatile bool Trace::recording = false;
+
+/**
+ * Clock of the trace, started with the recording.
+ * */
+static QElapsedTimer traceClock;
+
+/**
+ * Struct to store, in thread-local storage, the calling thread's buffer.
+ * The storage deletes it when the thread exits, but not the buffer.
+ */
+struct threadBuffer {
+    QVector<Trace::event> *events;
+};
+
+/**
+ * Events of every thread that recorded any, one buffer per thread.
+ * */
+static QList<QVector<Trace::event>*> buffers;
+static QMutex buffersMutex;
+static QThreadStorage<threadBuffer*> localBuffer;
+
+/**
+ * Give the calling thread a buffer (with buffersMutex locked).
+ * */
+static void registerThread() {
+    if (localBuffer.hasLocalData())
+        return;
+    threadBuffer *buffer = new threadBuffer;
+    buffer->events = new QVector<Trace::event>();
+    buffers.append(buffer->events);
+    localBuffer.setLocalData(buffer);
+}
+
+void Trace::start() {
+    QMutexLocker locker(&buffersMutex);
+    for (int i = 0; i < buffers.size(); i++)
+        buffers[i]->clear();
+    // The thread starting the trace gets the first timeline
+    registerThread();
+    traceClock.start();
+    recording = true;
+}
+
+bool Trace::isCompiledIn() {
+#ifdef PSQP_TRACE
+    return true;
+#else
+    return false;
+#endif
+}
+
+qint64 Trace::now() {
+    return traceClock.nsecsElapsed();
+}
+
+void Trace::record(const char *name, qint64 start, qint64 duration) {
+    if (!localBuffer.hasLocalData()) {
+        QMutexLocker locker(&buffersMutex);
+        registerThread();
+    }
+    event e;
+    e.name = name;
+    e.start = start;
+    e.duration = duration;
+    // Only this thread appends to its buffer
+    localBuffer.localData()->events->append(e);
+}
+
+void Trace::write(QString traceFile) {
+    recording = false;
+    QMutexLocker locker(&buffersMutex);
+
+    QFile file(traceFile);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        qFatal("Could not write trace %s.\n", qPrintable(traceFile));
+
+    // Complete events ("X"), in microseconds, with one timeline per thread
+    QTextStream out(&file);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    int nevents = 0;
+    for (int t = 0; t < buffers.size(); t++) {
+        out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+            << "\"tid\": " << t << ", \"args\": {\"name\": \""
+            << (t == 0 ? QString("main") : "thread " + QString::number(t)) << "\"}}";
+        first = false;
+        QVector<event> &events = *buffers[t];
+        for (int i = 0; i < events.size(); i++) {
+            out << ",\n{\"name\": \"" << events[i].name << "\", \"ph\": \"X\", \"pid\": 1, "
+                << "\"tid\": " << t << ", \"ts\": " << QString::number(events[i].start / 1000.0, 'f', 3)
+                << ", \"dur\": " << QString::number(events[i].duration / 1000.0, 'f', 3) << "}";
+        }
+        nevents += events.size();
+    }
+    out << "\n]}\n";
+
+    qDebug() << "Trace: " << traceFile << "(" << nevents << "events )";
+}
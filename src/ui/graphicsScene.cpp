@@ -12,7 +12,6 @@ QPointF GraphicsScene::getCenter() {
 }
 
 void GraphicsScene::showTiledImage(TiledImage *tiledImage) {
-	Tile *tiles = tiledImage->getTiles();
 	int ncols = tiledImage->getNCols();
 	int nrows = tiledImage->getNRows();
 
@@ -20,9 +19,9 @@ void GraphicsScene::showTiledImage(TiledImage *tiledImage) {
 	int index = 0;
 	for (int i = 0; i < nrows; i++) {
 		for (int j = 0; j < ncols; j++, index++) {
-			QGraphicsPixmapItem *pix = this->addPixmap(QPixmap::fromImage(tiles[index].getImage()));
-			pix->setOffset(j * tiles[index].getWidth(),
-					i * tiles[index].getHeight());
+			Tile *tile = tiledImage->getTile(index);
+			QGraphicsPixmapItem *pix = this->addPixmap(QPixmap::fromImage(tile->getView()));
+			pix->setOffset(j * tile->getWidth(), i * tile->getHeight());
 		}
 	}
 }
@@ -6,6 +6,10 @@ MainWindow::MainWindow(PSQP *psqp) :
     this->psqp = psqp;
     graphicsView = NULL;
     graphicsScene = NULL;
+    solverThread = new SolverThread(psqp, this);
+    connect(solverThread, SIGNAL(finished()), this, SLOT(solverFinished()));
+    connect(psqp->getMonitor(), SIGNAL(progress(int, int, int, double)), this,
+            SLOT(solverProgress(int, int, int, double)));
 
     ui->setupUi(this);
     setAttribute(Qt::WA_DeleteOnClose);
@@ -17,6 +21,11 @@ MainWindow::MainWindow(PSQP *psqp) :
 }
 
 MainWindow::~MainWindow() {
+    // Stop a running solve before the puzzle goes away
+    if (solverThread->isRunning()) {
+        psqp->getMonitor()->cancel();
+        solverThread->wait();
+    }
     delete ui;
     delete mainFrame;
 }
@@ -46,15 +55,27 @@ void MainWindow::open() {
 }
 
 void MainWindow::loadImage(QString filename) {
-    QImage file(filename);
-    if (file.isNull()) {
-        QMessageBox::information(this, tr("Load Warning"),
-                tr("Cannot read file %1.").arg(filename));
-        return;
+    // A puzzle file is loaded by updatePuzzle, and fixes the puzzle's size and descriptor
+    if (filename.endsWith(".psqp")) {
+        puzzleFile = filename;
+    } else {
+        QImage file(filename);
+        if (file.isNull()) {
+            QMessageBox::information(this, tr("Load Warning"),
+                    tr("Cannot read file %1.").arg(filename));
+            return;
+        }
+        puzzleFile.clear();
     }
     QApplication::setOverrideCursor(Qt::WaitCursor);
 
-    psqp->setImage(filename);
+    if (puzzleFile.isEmpty())
+        psqp->setImage(filename);
+    hGridSpin->setEnabled(puzzleFile.isEmpty());
+    wGridSpin->setEnabled(puzzleFile.isEmpty());
+    descriptorCombo->setEnabled(puzzleFile.isEmpty());
+    pSpin->setEnabled(puzzleFile.isEmpty());
+    qSpin->setEnabled(puzzleFile.isEmpty());
 
     if (graphicsScene != NULL) {
         graphicsScene->deleteLater();
@@ -63,6 +84,8 @@ void MainWindow::loadImage(QString filename) {
         randomGridButton->setEnabled(false);
         quadProgButton->setEnabled(false);
         shiftButton->setEnabled(false);
+        refineButton->setEnabled(false);
+        undoButton->setEnabled(false);
     }
 
     graphicsScene = new GraphicsScene(graphicsView);
@@ -120,6 +143,8 @@ void MainWindow::createDock() {
     wGridSpin->setRange(0, 5000);
     descriptorCombo = new QComboBox(this);
     descriptorCombo->addItems(psqp->getDescriptorNames());
+    solverCombo = new QComboBox(this);
+    solverCombo->addItems(psqp->getSolverNames());
     pSpin = new QDoubleSpinBox;
     pSpin->setValue(1.0);
     pSpin->setRange(0.0, 50.0);
@@ -143,6 +168,8 @@ void MainWindow::createDock() {
     hBox2->addWidget(new QLabel(tr(" / "), dock));
     hBox2->addWidget(qSpin);
     vBox->addWidget(w3);
+    vBox->addWidget(new QLabel(tr("Solver"), dock));
+    vBox->addWidget(solverCombo);
 
     resetPuzzleButton = new QPushButton("Reset puzzle");
     resetPuzzleButton->setEnabled(false);
@@ -160,11 +187,30 @@ void MainWindow::createDock() {
     connect(quadProgButton, SIGNAL(clicked()), this, SLOT(solvePuzzle()));
     vBox->addWidget(quadProgButton);
 
+    cancelButton = new QPushButton("Cancel");
+    cancelButton->setEnabled(false);
+    connect(cancelButton, SIGNAL(clicked()), this, SLOT(cancelSolver()));
+    vBox->addWidget(cancelButton);
+
+    progressBar = new QProgressBar;
+    progressBar->setValue(0);
+    vBox->addWidget(progressBar);
+
     shiftButton = new QPushButton("Optimize shift");
     shiftButton->setEnabled(false);
     connect(shiftButton, SIGNAL(clicked()), this, SLOT(optimizeShift()));
     vBox->addWidget(shiftButton);
 
+    refineButton = new QPushButton("Refine solution");
+    refineButton->setEnabled(false);
+    connect(refineButton, SIGNAL(clicked()), this, SLOT(refine()));
+    vBox->addWidget(refineButton);
+
+    undoButton = new QPushButton("Undo");
+    undoButton->setEnabled(false);
+    connect(undoButton, SIGNAL(clicked()), this, SLOT(undoPermutation()));
+    vBox->addWidget(undoButton);
+
     QSpacerItem* spacer = new QSpacerItem(20, 20, QSizePolicy::Minimum,
             QSizePolicy::Expanding);
     vBox->addItem(spacer);
@@ -175,12 +221,21 @@ void MainWindow::createDock() {
 
 void MainWindow::updatePuzzle() {
     graphicsScene->invalidate();
-    ncols = wGridSpin->value();
-    nrows = hGridSpin->value();
-    paramP = pSpin->value();
-    paramQ = qSpin->value();
-    psqp->setPuzzleSize(ncols, nrows);
-    psqp->setDescriptor(descriptorCombo->currentText(), paramP, paramQ);
+    if (puzzleFile.isEmpty()) {
+        ncols = wGridSpin->value();
+        nrows = hGridSpin->value();
+        paramP = pSpin->value();
+        paramQ = qSpin->value();
+        psqp->setPuzzleSize(ncols, nrows);
+        psqp->setDescriptor(descriptorCombo->currentText(), paramP, paramQ);
+    } else {
+        // Tiles are shown from the puzzle file's thumbnails
+        psqp->loadPuzzle(puzzleFile);
+        ncols = psqp->getTiledImage()->getNCols();
+        nrows = psqp->getTiledImage()->getNRows();
+        wGridSpin->setValue(ncols);
+        hGridSpin->setValue(nrows);
+    }
     statusBar()->showMessage(tr("Puzzle created"), 2000);
 
     graphicsScene->showTiledImage(psqp->getTiledImage());
@@ -192,6 +247,8 @@ void MainWindow::updatePuzzle() {
     randomGridButton->setEnabled(true);
     quadProgButton->setEnabled(true);
     shiftButton->setEnabled(true);
+    refineButton->setEnabled(true);
+    undoButton->setEnabled(true);
     graphicsView->fitInView(graphicsScene->sceneRect(), Qt::KeepAspectRatio);
 }
 
@@ -202,9 +259,52 @@ void MainWindow::permutTiles() {
 }
 
 void MainWindow::solvePuzzle() {
+    psqp->setSolver(solverCombo->currentText());
+    psqp->getMonitor()->reset();
+    setSolving(true);
+    progressBar->setValue(0);
+    statusBar()->showMessage(tr("Solving puzzle..."));
+    solverThread->setTask(SolverThread::SOLVE);
+    solverThread->start();
+}
+
+void MainWindow::cancelSolver() {
+    psqp->getMonitor()->cancel();
+    cancelButton->setEnabled(false);
+    statusBar()->showMessage(tr("Canceling..."));
+}
+
+void MainWindow::solverProgress(int done, int total, int iteration, double cost) {
+    progressBar->setRange(0, total);
+    progressBar->setValue(done);
+    statusBar()->showMessage(tr("Iteration %1, cost %2").arg(iteration).arg(cost));
+}
+
+void MainWindow::solverFinished() {
+    setSolving(false);
+    if (psqp->getMonitor()->isCanceled()) {
+        statusBar()->showMessage(tr("Solver canceled"), 2000);
+        return;
+    }
+    progressBar->setValue(progressBar->maximum());
     graphicsScene->invalidate();
-    psqp->runSolver();
     graphicsScene->showTiledImage(psqp->getTiledImage());
+    if (solverThread->getTask() == SolverThread::REFINE)
+        statusBar()->showMessage(tr("Solution refined"), 2000);
+    else
+        statusBar()->showMessage(tr("Puzzle solved"), 2000);
+}
+
+void MainWindow::setSolving(bool solving) {
+    ui->actionOpen->setEnabled(!solving);
+    resetPuzzleButton->setEnabled(!solving);
+    randomGridButton->setEnabled(!solving);
+    quadProgButton->setEnabled(!solving);
+    shiftButton->setEnabled(!solving);
+    refineButton->setEnabled(!solving);
+    undoButton->setEnabled(!solving);
+    solverCombo->setEnabled(!solving);
+    cancelButton->setEnabled(solving);
 }
 
 void MainWindow::optimizeShift() {
@@ -213,3 +313,23 @@ void MainWindow::optimizeShift() {
     statusBar()->showMessage(tr("Shift optimized"), 2000);
     graphicsScene->showTiledImage(psqp->getTiledImage());
 }
+
+void MainWindow::refine() {
+    psqp->getMonitor()->reset();
+    setSolving(true);
+    // Local search runs to its time budget, it cannot be canceled
+    cancelButton->setEnabled(false);
+    statusBar()->showMessage(tr("Refining solution..."));
+    solverThread->setTask(SolverThread::REFINE, REFINE_TIME_BUDGET);
+    solverThread->start();
+}
+
+void MainWindow::undoPermutation() {
+    if (!psqp->getTiledImage()->undoPermutation()) {
+        statusBar()->showMessage(tr("Nothing to undo"), 2000);
+        return;
+    }
+    graphicsScene->invalidate();
+    statusBar()->showMessage(tr("Permutation undone"), 2000);
+    graphicsScene->showTiledImage(psqp->getTiledImage());
+}
@@ -0,0 +1,24 @@
+#include "ui/solverThread.h"
+
+SolverThread::SolverThread(PSQP *psqp, QObject *parent) :
+        QThread(parent) {
+    this->psqp = psqp;
+    task = SOLVE;
+    timeBudget = 0;
+}
+
+void SolverThread::setTask(int task, int timeBudget) {
+    this->task = task;
+    this->timeBudget = timeBudget;
+}
+
+int SolverThread::getTask() {
+    return task;
+}
+
+void SolverThread::run() {
+    if (task == REFINE)
+        psqp->refine(timeBudget);
+    else
+        psqp->runSolver();
+}
@@ -0,0 +1,53 @@
+#include <iostream>
+
+#include "tile/descriptor/colorConversion.h"
+
+using namespace std;
+
+/**
+ * Check the batched RGB to LAB conversion against the per-pixel one, over
+ * every 24-bit color. Both must give exactly the same values.
+ * */
+int main() {
+    const int n = 256 * 256;
+    float *rgb = new float[3 * n];
+    float *lab = new float[3 * n];
+    float pixel[3], expected[3];
+    long mismatches = 0;
+
+    // One red value at a time: every green and blue value in a batch
+    for (int r = 0; r < 256; r++) {
+        for (int g = 0; g < 256; g++) {
+            for (int b = 0; b < 256; b++) {
+                int i = 3 * (b + g * 256);
+                rgb[i] = r;
+                rgb[i + 1] = g;
+                rgb[i + 2] = b;
+            }
+        }
+        ColorConversion::RGBtoLAB(rgb, lab, n);
+
+        for (int i = 0; i < 3 * n; i += 3) {
+            // RGBtoLAB(float[], float[]) scales its input in place
+            pixel[0] = rgb[i];
+            pixel[1] = rgb[i + 1];
+            pixel[2] = rgb[i + 2];
+            ColorConversion::RGBtoLAB(pixel, expected);
+            for (int c = 0; c < 3; c++) {
+                if (lab[i + c] != expected[c]) {
+                    if (mismatches < 10)
+                        cout << "RGB (" << rgb[i] << ", " << rgb[i + 1] << ", " << rgb[i + 2]
+                             << ") channel " << c << ": " << lab[i + c] << " != " << expected[c] << '\n';
+                    mismatches++;
+                }
+            }
+        }
+    }
+
+    delete[] rgb;
+    delete[] lab;
+
+    cout << "RGB to LAB: " << (mismatches == 0 ? "OK" : "FAILED") << " ("
+         << mismatches << " mismatches over 2^24 colors)" << '\n';
+    return (mismatches == 0) ? 0 : 1;
+}
@@ -0,0 +1,16 @@
+TEMPLATE = app
+TARGET = psqp-test
+
+CONFIG += console
+CONFIG -= app_bundle
+
+QMAKE_CXXFLAGS_WARN_ON += -Wno-unused-parameter
+
+QT += core
+MOC_DIR += ./tmp
+INCLUDEPATH += $$PWD/../include/
+OBJECTS_DIR += ./obj
+
+SOURCES = $$PWD/colorConversionTest.cpp \
+    $$PWD/../src/tile/descriptor/colorConversion.cpp
+HEADERS = $$PWD/../include/tile/descriptor/colorConversion.h